@@ -20,6 +20,7 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.*/
 
+#include "adcscan.h"
 #include "GPIO.h"
 
  //Pin number in port
@@ -28,16 +29,24 @@ GPIO_InitTypeDef GPIO_STRUCT;
 
 //Set GPIO Pin register to HIGH
 void (SET_ECU_GPIO_HIGH)(uint8_t PIN,uint32_t _clock_){
+    GPIO_TypeDef* port = ECU_GPIO_PORT(_clock_);
+    if(port == 0){
+        return;
+    }
     SET_GPIO_MODE(PIN,OUT,_clock_);
     //SET HIGH
-    GPIO_WriteBit(GPIOD,PIN,Bit_SET);
+    GPIO_WriteBit(port,PIN,Bit_SET);
 }
 
 //Set GPIO Pin register to LOW
 void (SET_ECU_GPIO_LOW)(uint8_t PIN,uint32_t _clock_){
+    GPIO_TypeDef* port = ECU_GPIO_PORT(_clock_);
+    if(port == 0){
+        return;
+    }
     SET_GPIO_MODE(PIN,OUT,_clock_);
     //SET LOW
-    GPIO_WriteBit(GPIOD,PIN,Bit_RESET);
+    GPIO_WriteBit(port,PIN,Bit_RESET);
 }
 
 void (GPIO_READ_DIGITAL)(uint8_t PIN,uint32_t _clock_){
@@ -46,8 +55,23 @@ void (GPIO_READ_DIGITAL)(uint8_t PIN,uint32_t _clock_){
 
 }
 
-void (GPIO_READ_ANALOG)(uint8_t PIN,uint32_t _clock_){
-
+//Latest sample from the background scan of ADC1 when it covers the pin,
+//see adcscan.h. Otherwise a conversion on the spot, unless the scan owns
+//the ADC, then ECU_ADC_NONE. The pin is switched to analog on the first
+//read only, later reads just check its mode
+uint16_t (GPIO_READ_ANALOG)(uint8_t PIN,uint32_t _clock_){
+    int chan = ECU_ADC_CHANNEL(PIN,_clock_);
+    if(chan < 0){
+        return ECU_ADC_NONE;
+    }
+    int pin = __builtin_ctz(PIN);
+    if(((ECU_GPIO_PORT(_clock_)->MODER >> 2 * pin) & 3) != GPIO_Mode_AN){
+        SET_GPIO_MODE(PIN,GPIO_Mode_AN,_clock_);
+    }
+    if(AdcScan<1>::has(chan)){
+        return AdcScan<1>::latest(chan);
+    }
+    return AdcScan<1>::running() ? ECU_ADC_NONE : ADC<1>::read((uint8_t) chan);
 }
 
 void (GPIO_WRITE)(uint8_t PIN,uint32_t _clock_){
@@ -57,6 +81,10 @@ void (GPIO_WRITE)(uint8_t PIN,uint32_t _clock_){
 //Set GPIO-Mode (IN,OUT,Analog,Alternate function)
 void (SET_GPIO_MODE)(uint8_t PIN,uint8_t mode,uint32_t _clock_){
     //Decide Port
+    GPIO_TypeDef* port = ECU_GPIO_PORT(_clock_);
+    if(port == 0){
+        return;
+    }
     //Provide clock to the specific port being used.
     //Parameter refernece
     RCC_AHB1PeriphClockCmd(_clock_,ENABLE);
@@ -69,5 +97,25 @@ void (SET_GPIO_MODE)(uint8_t PIN,uint8_t mode,uint32_t _clock_){
     GPIO_STRUCT.GPIO_Speed=GPIO_Speed_50MHz;
     GPIO_STRUCT.GPIO_PuPd=GPIO_OType_PP;
     //GPIO Initialization
-    GPIO_Init(GPIOD,&GPIO_STRUCT);
-}
\ No newline at end of file
+    GPIO_Init(port,&GPIO_STRUCT);
+}
+
+//ADC channel of a pin: PA0..7 -> 0..7, PB0..1 -> 8..9, PC0..5 -> 10..15
+//PIN must be exactly one pin, _clock_ exactly one port
+int (ECU_ADC_CHANNEL)(uint8_t PIN,uint32_t _clock_){
+    if(PIN == 0 || (PIN & (PIN - 1)) != 0 || ECU_GPIO_PORT(_clock_) == 0){
+        return -1;
+    }
+    int pin = __builtin_ctz(PIN), port = __builtin_ctz(_clock_);
+    return port == 0 ? pin :
+           port == 1 && pin < 2 ? pin + 8 :
+           port == 2 && pin < 6 ? pin + 10 : -1;
+}
+
+//Port belonging to a clock enable bit, GPIOA..GPIOI are 0x400 apart
+GPIO_TypeDef* (ECU_GPIO_PORT)(uint32_t _clock_){
+    if(_clock_ == 0 || (_clock_ & (_clock_ - 1)) != 0 || _clock_ > RCC_AHB1Periph_GPIOI){
+        return 0;
+    }
+    return (GPIO_TypeDef*)(GPIOA_BASE + 0x400 * __builtin_ctz(_clock_));
+}
@@ -26,6 +26,11 @@ SOFTWARE.*/
 #include "../stm32/spl/variants/stm32f4/src/stm32f4xx_gpio.c"
 #include "../stm32/cmsis/variants/stm32f4/stm32f4xx.h"
 
+//CMSIS defines DWT and ADC as register block pointers, which hide the
+//JeeH DWT and ADC templates. The SPL GPIO driver uses neither
+#undef DWT
+#undef ADC
+
 //0x1
 #define CLOCK_A (RCC_AHB1Periph_GPIOA)
 //0x2
@@ -39,7 +44,12 @@ SOFTWARE.*/
 
 #define OUT (GPIO_Mode_OUT)
 
+//No sample for the pin: it has no ADC channel, or the ADC1 scan runs
+//without it. Samples are 12 bits, so this is never a reading
+#define ECU_ADC_NONE 0xFFFF
+
 //Setup Function
+//Slow path, configures the pin on every call. See pins.h for fast writes
 
 //Set GPIO Pin register to HIGH
 void (SET_ECU_GPIO_HIGH)(uint8_t PIN,uint32_t _clock_);
@@ -50,8 +60,8 @@ void (SET_ECU_GPIO_LOW)(uint8_t PIN,uint32_t _clock_);
 //
 void (GPIO_READ_DIGITAL)(uint8_t PIN,uint32_t _clock_);
 
-//
-void (GPIO_READ_ANALOG)(uint8_t PIN,uint32_t _clock_);
+//Analog value of a pin, 12 bits, or ECU_ADC_NONE, see GPIO.c
+uint16_t (GPIO_READ_ANALOG)(uint8_t PIN,uint32_t _clock_);
 
 //
 void (GPIO_WRITE)(uint8_t PIN,uint32_t _clock_);
@@ -59,6 +69,13 @@ void (GPIO_WRITE)(uint8_t PIN,uint32_t _clock_);
 //Set GPIO-Mode (IN,OUT,Analog,Alternate function)
 void (SET_GPIO_MODE)(uint8_t PIN,uint8_t mode,uint32_t _clock_);
 
+//ADC channel of a pin, -1 if it has none or PIN is not a single pin
+int (ECU_ADC_CHANNEL)(uint8_t PIN,uint32_t _clock_);
+
+//Port belonging to a clock (CLOCK_A -> GPIOA, ...), 0 unless _clock_ is
+//exactly one of them. The slow path functions do nothing then
+GPIO_TypeDef* (ECU_GPIO_PORT)(uint32_t _clock_);
+
 
 
 #endif //ECU_GPIO
\ No newline at end of file
@@ -0,0 +1,200 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef ECU_ACTUATOR_
+#define ECU_ACTUATOR_
+
+#include "../lib/jeeh-fork-master/jee.h"
+#include "../Control/cascade.h"
+#include "adcscan.h"
+
+//Linear actuator driven by a Cascade, C describes the hardware:
+//  pwmTimer, pwmChannel, drive (pin) - motor PWM, dir (pin) - direction
+//  trigChannel - compare channel of pwmTimer that starts the current
+//      sample, one with an injected ADC trigger (see ADC::injectedEvent)
+//  currentAdc, currentChan - sampled once per PWM period at the centre of
+//      the on-time, where the ripple crosses the mean current, as an
+//      injected conversion: timer triggered, it pre-empts regular
+//      conversions and scans on the same ADC. The end of injected
+//      conversion interrupt runs the current loop
+//  positionAdc, positionChan - read by the velocity loop, taken from the
+//      last frame of an AdcScan of that ADC if one runs with the channel,
+//      converted on the spot if none runs. A scan there without the
+//      channel owns the ADC: the first velocity tick stops the drive
+//      rather than break the scan. Start the scan after init()
+//  velocityTimer, velocityHz, positionTimer, positionHz - loop rates
+//  ampsPerCount, currentZero, metresPerCount - sensor scaling
+//Priorities: current loop 1, velocity loop 2, position loop 3
+//ADC1..3 share one interrupt vector, so with two drives install a handler
+//that calls both currentIrq(), each one only acts on its own conversion
+template< typename C >
+struct ActuatorDrive {
+    typedef Timer<C::pwmTimer> pwm;
+    typedef ADC<C::currentAdc> current;
+    typedef ADC<C::positionAdc> position;
+    typedef AdcScan<C::positionAdc> scan;
+    typedef Timer<C::velocityTimer> velocityTimer;
+    typedef Timer<C::positionTimer> positionTimer;
+
+    static_assert(current::injectedEvent(C::pwmTimer, C::trigChannel) >= 0,
+                  "trigChannel of pwmTimer cannot trigger injected conversions");
+
+    static void init (uint32_t pwmHz, uint32_t pwmClock, uint32_t velClock, uint32_t posClock) {
+        period = pwmClock / pwmHz / 2;
+        cascade.init(C::velocityHz, 0.2f);
+
+        C::dir::mode(Pinmode::out);
+        C::drive::mode(Pinmode::alt_out, pwm::alt);
+        //counting up to period and back, the on-time is centred on the
+        //valley, where the trigger channel matches on the way down
+        pwm::init(period + 1);
+        pwm::centered();
+        pwm::pwm(0, C::pwmChannel);
+        pwm::compare(C::trigChannel, 1, 0b110);
+
+        current::init();
+        current::sampleTime(C::currentChan, 0b010);
+        current::inject(C::currentChan, current::injectedEvent(C::pwmTimer, C::trigChannel));
+        current::injectedInterrupt(currentIrq);
+        nvicPriority(18, 1);
+
+        position::init();
+        position::sampleTime(C::positionChan, 0b011);
+
+        velocityTimer::initHz(C::velocityHz, velClock);
+        velocityTimer::interrupt(velocityIrq);
+        nvicPriority(velocityTimer::irq, 2);
+
+        positionTimer::initHz(C::positionHz, posClock);
+        positionTimer::interrupt(positionIrq);
+        nvicPriority(positionTimer::irq, 3);
+    }
+
+    //Stop all three loops and idle the motor, e.g. before writing flash
+    //Call resume() to carry on, or init() again to start afresh
+    static void stop () {
+        Periph::bit(positionTimer::dier, 0) = 0; // UIE
+        Periph::bit(velocityTimer::dier, 0) = 0;
+        Periph::bit(current::cr1, 7) = 0; // JEOCIE
+        MMIO32(pwm::ccr(C::pwmChannel)) = 0;
+    }
+
+    //Run the loops again after stop(), set-up, gains and loop state as
+    //they were. Meant for short stops, like the 100 us of a flash write,
+    //after longer ones init() the drive again or Cascade::restart() it
+    static void resume () {
+        velocityTimer::clear();
+        positionTimer::clear();
+        Periph::bit(current::cr1, 7) = 1; // JEOCIE
+        Periph::bit(velocityTimer::dier, 0) = 1; // UIE
+        Periph::bit(positionTimer::dier, 0) = 1;
+    }
+
+    //Position gains of an earlier auto-tune, kept under "axis" in the
+    //GainStore S. Call before init(), with the position PID's limits set
+    template< typename S >
+    static bool loadGains (int axis) {
+        TunedGains g;
+        if (!S::load(axis, g))
+            return false;
+        cascade.tuned(g);
+        return true;
+    }
+
+    //Keep the result of a finished auto-tune in the GainStore S, once.
+    //Idles the drive while the flash is busy, the loops restart from a
+    //fresh position sample if that took a sector erase. Poll from the
+    //main loop
+    template< typename S >
+    static bool saveTuned (int axis) {
+        if (cascade.relay.state != RelayTune::DONE)
+            return false;
+        stop();
+        bool erased = S::save(axis, cascade.relay.result);
+        cascade.relay.stop();
+        uint16_t counts;
+        if (erased) {
+            if (!sample(counts))
+                return true;
+            cascade.restart(counts * C::metresPerCount);
+        }
+        resume();
+        return true;
+    }
+
+    //New position setpoint in metres, safe from any context
+    static void moveTo (float32_t metres) { cascade.target.write(metres); }
+
+    //Stopped drives keep converting, the shared vector can still get here
+    static void currentIrq () {
+        if (!Periph::bit(current::cr1, 7) || // JEOCIE, off when stopped
+                !Periph::bit(current::sr, 2)) // JEOC
+            return;
+        MMIO32(current::sr) = ~(1<<2); // rc_w0
+        uint16_t v = MMIO32(current::jdr1);
+        float32_t duty = cascade.currentTick((v - C::currentZero) * C::ampsPerCount);
+        C::dir::write(duty < 0);
+        MMIO32(pwm::ccr(C::pwmChannel)) = (duty < 0 ? -duty : duty) * period;
+    }
+
+    //A latched stall fault, see Cascade::watch(), idles the drive
+    static void velocityIrq () {
+        velocityTimer::clear();
+        uint16_t counts;
+        if (!sample(counts)) {
+            stop();
+            return;
+        }
+        cascade.velocityTick(counts * C::metresPerCount);
+        if (cascade.stall.fault != cascade.stall.NONE)
+            stop();
+    }
+
+    //Position counts, false if a scan owns the ADC without the channel:
+    //a conversion now would rewrite the scan's sequence
+    static bool sample (uint16_t& counts) {
+        if (scan::has(C::positionChan))
+            counts = scan::latest(C::positionChan);
+        else if (!scan::running())
+            counts = position::read(C::positionChan);
+        else
+            return false;
+        return true;
+    }
+
+    static void positionIrq () {
+        positionTimer::clear();
+        cascade.positionTick();
+    }
+
+    static Cascade cascade;
+    static uint32_t period;
+};
+
+template< typename C >
+Cascade ActuatorDrive<C>::cascade;
+
+template< typename C >
+uint32_t ActuatorDrive<C>::period;
+
+#endif //ECU_ACTUATOR
@@ -0,0 +1,79 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+#ifndef ECU_ADCBLOCKS_
+#define ECU_ADCBLOCKS_
+
+#include "../lib/jeeh-fork-master/jee.h"
+
+//Background conversion of C channels on ADC<N> for block filters, e.g.
+//Decimator: scan mode, running continuously, circular DMA into a ring of
+//two halves of F frames. Each time a half is full, the DMA interrupt
+//hands it to the handler, F frames of C samples in list order, while the
+//other half fills. The handler has F frames' time, and nothing runs per
+//sample. AdcScan is the way to get just the latest frame instead, the two
+//can't share an ADC
+template< int N, int C, int F >
+struct AdcBlocks {
+    typedef ADC<N> adc;
+    typedef typename adc::dma dma;
+    typedef void (*Handler) (uint16_t const* frames, int count);
+
+    //chans - C channels 0..18, sample - 0b000..0b111 for all of them,
+    //prio - of the DMA interrupt the handler runs from
+    static void init (uint8_t const* chans, Handler handler, int sample =0b111, int prio =4) {
+        block = handler;
+        adc::init();
+        for (int i = 0; i < C; ++i)
+            adc::sampleTime(chans[i], sample);
+        dma::init(adc::dmaChan, adc::dr, (void const*) ring, 2 * F * C,
+                    dma::circular | dma::memInc | dma::halfWords | dma::high |
+                    dma::irqHalf | dma::irqDone);
+        dma::interrupt(dmaIrq);
+        nvicPriority(dma::irq, prio);
+        adc::scan(chans, C);
+    }
+
+    //Both flags at once means the handler fell half a ring behind, the
+    //older half is then already being overwritten
+    static void dmaIrq () {
+        uint32_t f = dma::flags();
+        dma::clear();
+        if (f & dma::halfDone)
+            block((uint16_t const*) ring[0], F);
+        if (f & dma::done)
+            block((uint16_t const*) ring[1], F);
+    }
+
+    static uint16_t volatile ring [2][F * C];
+    static Handler block;
+};
+
+template< int N, int C, int F >
+uint16_t volatile AdcBlocks<N,C,F>::ring [2][F * C];
+
+template< int N, int C, int F >
+typename AdcBlocks<N,C,F>::Handler AdcBlocks<N,C,F>::block;
+
+#endif //ECU_ADCBLOCKS
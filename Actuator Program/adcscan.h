@@ -0,0 +1,101 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef ECU_ADCSCAN_
+#define ECU_ADCSCAN_
+
+#include "../lib/jeeh-fork-master/jee.h"
+
+//Background conversion of a channel list on ADC<N>: scan mode, running
+//continuously, DMA in double-buffer mode into two frames. While the DMA
+//fills one frame the other holds the last complete scan, so the control
+//code gets its samples without starting or waiting for a conversion, and
+//the ADC costs no CPU time at all between reads
+//All channels share one sampling time. A frame takes count * (sampling
+//time + 12) ADC clocks, e.g. 3 channels at 56 cycles: 204 clocks, 9.7 us
+template< int N >
+struct AdcScan {
+    typedef ADC<N> adc;
+    typedef typename adc::dma dma;
+    enum { MAX = 16, CHANNELS = 19 };   //16 inputs, temperature, vref, vbat
+
+    //chans - channel list 0..18, count 1..16, sample - 0b000..0b111
+    static void init (uint8_t const* chans, int count, int sample =0b011) {
+        n = count;
+        for (int c = 0; c < CHANNELS; ++c)
+            slot[c] = 0;
+        adc::init();
+        for (int i = 0; i < count; ++i) {
+            adc::sampleTime(chans[i], sample);
+            slot[chans[i]] = i + 1;
+        }
+        dma::init(adc::dmaChan, adc::dr, (void const*) frame[0], count,
+                    dma::circular | dma::memInc | dma::halfWords | dma::high |
+                    dma::doubleBuf, (void const*) frame[1]);
+        adc::scan(chans, count);
+    }
+
+    static bool running () { return n != 0; }
+    static bool has (uint8_t chan) { return chan < CHANNELS && slot[chan] != 0; }
+
+    //Latest sample of one channel in the list, a single read is always whole
+    static uint16_t latest (uint8_t chan) { return frame[dma::target() ^ 1][slot[chan] - 1]; }
+
+    //Copy of the last complete scan, in list order. If the DMA moves on
+    //to that frame meanwhile the copy is taken again from the new one.
+    //Interrupts are held off for the copy, a few cycles per channel, so
+    //it can't be overtaken twice unseen. On the host simulator interrupts
+    //only run between events, there is nothing to hold off
+    static void read (uint16_t* out) {
+#ifdef __arm__
+        uint32_t mask;
+        __asm volatile ("mrs %0, primask\n cpsid i" : "=r" (mask) :: "memory");
+#endif
+        for (;;) {
+            int ct = dma::target();
+            uint16_t volatile const* f = frame[ct ^ 1];
+            for (int i = 0; i < n; ++i)
+                out[i] = f[i];
+            if (dma::target() == ct)
+                break;
+        }
+#ifdef __arm__
+        __asm volatile ("msr primask, %0" :: "r" (mask) : "memory");
+#endif
+    }
+
+    static uint16_t volatile frame [2][MAX];
+    static uint8_t slot [CHANNELS];     //1 + position of each channel in a frame, 0 = none
+    static int n;
+};
+
+template< int N >
+uint16_t volatile AdcScan<N>::frame [2][MAX];
+
+template< int N >
+uint8_t AdcScan<N>::slot [CHANNELS];
+
+template< int N >
+int AdcScan<N>::n;
+
+#endif //ECU_ADCSCAN
@@ -0,0 +1,56 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef ECU_BENCH_
+#define ECU_BENCH_
+
+#include "../lib/jeeh-fork-master/jee.h"
+#include "GPIO.h"
+#include "pins.h"
+
+//Average cycles for one valve write through SET_ECU_GPIO_HIGH/LOW (spl)
+//and through the pin descriptor P (bsrr). The pin is toggled runs times
+//The SPL path takes a uint8_t pin mask, so P must be one of pins 0..7
+template< typename P >
+void (BENCH_ECU_GPIO)(uint32_t* spl, uint32_t* bsrr, int runs =64){
+    constexpr uint32_t clock = RCC_AHB1Periph_GPIOA << (P::pin::gpio::base - GPIOA_BASE) / 0x400;
+    static_assert(P::set < 0x100, "SPL path only handles pins 0..7");
+
+    DWT::start();
+    uint32_t start = DWT::count();
+    for (int i = 0; i < runs; ++i) {
+        SET_ECU_GPIO_HIGH(P::set,clock);
+        SET_ECU_GPIO_LOW(P::set,clock);
+    }
+    *spl = (DWT::count() - start) / (2 * runs);
+
+    P::init();
+    start = DWT::count();
+    for (int i = 0; i < runs; ++i) {
+        P::high();
+        P::low();
+    }
+    *bsrr = (DWT::count() - start) / (2 * runs);
+}
+
+#endif //ECU_BENCH
@@ -0,0 +1,184 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+#ifndef ECU_CAPTURE_
+#define ECU_CAPTURE_
+
+#include "../lib/jeeh-fork-master/jee.h"
+
+//Transient recorder: ADC1..3 interleaved on one channel, one sample every
+//"delay" ADC clocks (4.2 MS/s at 5, ADC::clockHz is 21 MHz), streamed by
+//DMA into a ring of S samples. trigger() fixes the window around the
+//moment it is called, "pre" samples before and "post" after, and the
+//capture stops by itself once those are in, at the next half of the
+//ring. So pre + post must leave half the ring plus some slack for the
+//stop to land without overwriting the window. Call trigger() from the
+//code that switches the valve or drive whose transient is wanted
+//Takes over ADC1..3 and DMA2 stream 0 (see ADC::interleave()), so stop
+//AdcScans and drives first and init() them again when done
+template< int S >
+struct TransientCapture {
+    typedef ADC<1> adc;
+    typedef typename adc::dma dma;
+    enum { IDLE, RUNNING, TRIGGERED, DONE };
+    enum { SLACK = 64 };    //samples the DMA may add while the stop is pending
+    static_assert(S % 4 == 0, "the ring is two halves of whole words");
+
+    //Start sampling "chan" (0..15), false if the window does not fit
+    static bool start (uint8_t chan, int preSamples, int postSamples, int delay =5) {
+        if (preSamples < 0 || postSamples < 1 || preSamples + postSamples > S / 2 - SLACK)
+            return false;
+        pre = preSamples;
+        post = postSamples;
+        hz = adc::clockHz / delay;
+        written = 0;
+        state = RUNNING;
+        dma::init(adc::dmaChan, adc::cdr, (void const*) ring, S / 2,
+                    dma::circular | dma::memInc | dma::words | dma::high |
+                    dma::irqHalf | dma::irqDone);
+        dma::interrupt(dmaIrq);
+        nvicPriority(dma::irq, 0);
+        adc::interleave(chan, delay);
+        return true;
+    }
+
+    //Mark now as the moment of the transient, safe from any context
+    //Only the first trigger() after start() counts
+    static void trigger () {
+        if (state != RUNNING)
+            return;
+        //next sample to be written, counted on from the last half the
+        //interrupt saw, which may lag the DMA by one half. Taken again if
+        //the interrupt came in between
+        uint32_t w, next;
+        do {
+            w = written;
+            next = S - 2 * dma::remaining();
+        } while (w != written);
+        uint32_t at = w + (next - w % S + S) % S;
+        first = at - (at < (uint32_t) pre ? at : pre);
+        mark = at;
+        stopAt = at + post;
+        state = TRIGGERED;
+    }
+
+    static bool done () { return state == DONE; }
+
+    //Abandon a capture, e.g. when the trigger never came
+    static void stop () {
+        Periph::bit(dma::cr, 0) = 0; // EN
+        adc::independent();
+        if (state != DONE)
+            state = IDLE;
+    }
+
+    //The window once done(): count() samples, trigger() was called just
+    //before sample index marked()
+    static int count () { return stopAt - first; }
+    static int marked () { return mark - first; }
+    static uint16_t sample (int i) {
+        uint32_t k = (first + i) % S;
+        return ring[k / 2] >> 16 * (k & 1);
+    }
+
+    //Binary dump of the window: a text line "capture <count> <hz> <marked>",
+    //the samples as little-endian 16-bit words, then a line "sum <s>" with
+    //their sum modulo 65536, to check the block against
+    //U is any JeeH serial device, it is written to directly
+    template< typename U >
+    static void send () {
+        print<U>("capture ", count());
+        print<U>(" ", hz);
+        print<U>(" ", marked());
+        U::putc('\n');
+        uint16_t sum = 0;
+        for (int i = 0; i < count(); ++i) {
+            uint16_t v = sample(i);
+            U::putc(v & 0xFF);
+            U::putc(v >> 8);
+            sum += v;
+        }
+        print<U>("sum ", sum);
+        U::putc('\n');
+    }
+
+    template< typename U >
+    static void print (char const* s, uint32_t v) {
+        while (*s)
+            U::putc(*s++);
+        char d [10];
+        int n = 0;
+        do
+            d[n++] = '0' + v % 10;
+        while ((v /= 10) != 0);
+        while (n > 0)
+            U::putc(d[--n]);
+    }
+
+    //A half of the ring is complete, stop once the window is in
+    static void dmaIrq () {
+        dma::clear();
+        written += S / 2;
+        if (state == TRIGGERED && written >= stopAt) {
+            stop();
+            state = DONE;
+        }
+    }
+
+    static uint32_t volatile ring [S / 2];  //two samples per word, low half first
+    static uint32_t volatile written;       //samples before the last half seen
+    static uint32_t first, mark, stopAt;    //window, in samples since start()
+    static uint32_t hz;
+    static int pre, post;
+    static int volatile state;
+};
+
+template< int S >
+uint32_t volatile TransientCapture<S>::ring [S / 2];
+
+template< int S >
+uint32_t volatile TransientCapture<S>::written;
+
+template< int S >
+uint32_t TransientCapture<S>::first;
+
+template< int S >
+uint32_t TransientCapture<S>::mark;
+
+template< int S >
+uint32_t TransientCapture<S>::stopAt;
+
+template< int S >
+uint32_t TransientCapture<S>::hz;
+
+template< int S >
+int TransientCapture<S>::pre;
+
+template< int S >
+int TransientCapture<S>::post;
+
+template< int S >
+int volatile TransientCapture<S>::state;
+
+#endif //ECU_CAPTURE
@@ -0,0 +1,134 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef ECU_DEADTIME_
+#define ECU_DEADTIME_
+
+#include "../lib/jeeh-fork-master/jee.h"
+
+//Valve dead-time compensation with online response time identification
+//command() timestamps each open/close command (DWT cycles), moved() is
+//called from the valve feedback interrupt, e.g. an Exti on a position
+//switch. The latency in between updates a running average per valve and
+//direction: est += (latency - est) / 2^K, O(1) and no allocation
+//Commands are then advanced by the estimates, see advance() and width()
+//A timed pulse, see pulse(), has both its edges measured: the open one
+//against the command, the close one against the end of the pulse
+template< int N, int K =3 >
+struct DeadTime {
+    static_assert(N <= 32, "valves are tracked in a 32-bit mask");
+
+    //cpuHz - DWT clock, nominalUs - response time from cfg.txt as a start
+    //limitUs - longer latencies are taken as a missed edge and dropped
+    void init (uint32_t cpuHz, uint32_t nominalUs, uint32_t limitUs) {
+        cyclesPerUs = cpuHz / 1000000;
+        usPerCycle = (1ULL << 32) / cyclesPerUs;
+        limit = limitUs;
+        armed = pending = 0;
+        for (int v = 0; v < N; ++v) {
+            open[v] = close[v] = nominalUs << 8;
+            samples[v] = 0;
+        }
+    }
+
+    //Open or close command for valve v has just been issued
+    void command (int v, bool opening) {
+        stamp[v] = DWT::count();
+        direction = (direction & ~(1U << v)) | ((uint32_t) opening << v);
+        armed |= 1U << v;
+        pending &= ~(1U << v);
+    }
+
+    //Same, for every valve whose bit differs between two bank masks
+    void commandMask (uint32_t before, uint32_t after) {
+        for (uint32_t changed = before ^ after; changed != 0; changed &= changed - 1) {
+            int v = __builtin_ctz(changed);
+            command(v, ((after >> v) & 1) != 0);
+        }
+    }
+
+    //Valve v has just been opened for widthUs, closed by hardware, e.g. a
+    //timer in one-pulse mode. The close is stamped ahead and armed once
+    //the opening has been seen
+    void pulse (int v, uint32_t widthUs) {
+        command(v, true);
+        closeAt[v] = stamp[v] + widthUs * cyclesPerUs;
+        pending |= 1U << v;
+    }
+
+    //Feedback edge of valve v, only the first one after a command counts
+    void moved (int v) {
+        if (((armed >> v) & 1) == 0)
+            return;
+        armed &= ~(1U << v);
+        uint32_t us = ((uint64_t) (DWT::count() - stamp[v]) * usPerCycle) >> 32;
+        bool opening = (direction >> v) & 1;
+        if ((pending >> v) & 1) {
+            pending &= ~(1U << v);
+            stamp[v] = closeAt[v];
+            direction &= ~(1U << v);
+            armed |= 1U << v;
+        }
+        measured(v, opening, us);
+    }
+
+    //A latency of valve v taken some other way, e.g. from the coil current
+    void measured (int v, bool opening, uint32_t us) {
+        if (us > limit)
+            return;
+        int32_t& est = opening ? open[v] : close[v];
+        est += ((int32_t) (us << 8) - est) >> K;
+        ++samples[v];
+    }
+
+    //Estimated latencies in us
+    uint32_t openUs (int v) const { return open[v] >> 8; }
+    uint32_t closeUs (int v) const { return close[v] >> 8; }
+
+    //Response time for the flow planner, the slower direction
+    uint32_t response (int v) const {
+        return (open[v] > close[v] ? open[v] : close[v]) >> 8;
+    }
+
+    //Issue the open command this long before flow should start
+    uint32_t advance (int v) const { return openUs(v); }
+
+    //Commanded open time for a wanted flow time of us: flow starts the
+    //open latency after the command and stops the close latency after the
+    //end of it, so width + close - open = us
+    uint32_t width (int v, uint32_t us) const {
+        int32_t w = (int32_t) us - (int32_t) closeUs(v) + (int32_t) openUs(v);
+        return w > 0 ? w : 0;
+    }
+
+    int32_t open [N], close [N];    //estimates, us in 24.8 fixed point
+    uint32_t samples [N];           //measurements taken per valve
+    uint32_t stamp [N];             //DWT count of the last command
+    uint32_t closeAt [N];           //DWT count at the end of a pulse
+    uint32_t volatile armed;        //waiting for feedback, 1 bit per valve
+    uint32_t pending;               //pulse close still to measure
+    uint32_t direction;             //last command, 1 = open
+    uint32_t cyclesPerUs, usPerCycle, limit;
+};
+
+#endif //ECU_DEADTIME
@@ -0,0 +1,132 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef ECU_DRIVER_
+#define ECU_DRIVER_
+
+#include "../lib/jeeh-fork-master/jee.h"
+
+//Peak-and-hold solenoid drive, see linear actuators/cfg.txt
+//open() drives the coil at full duty for the pull-in time, then the timer
+//drops to the hold duty by itself. Pulling in hard shortens the opening
+//time, holding at low duty keeps the coil cool once the armature is seated
+//Needs the repetition counter, so TIM1 or TIM8, e.g. PeakHold<1,1,PinA<8>>
+template< int TIM, int CH, typename PIN >
+struct PeakHold {
+    typedef Timer<TIM> timer;
+    static_assert(TIM == 1 || TIM == 8, "peak-and-hold needs TIM1 or TIM8");
+
+    //pwmHz - coil PWM rate, at least timerHz/65536
+    //peakUs - pull-in time, rounded to whole PWM periods (max 256)
+    //holdPct - duty cycle once pulled in, in %
+    static void init (uint32_t pwmHz, uint32_t peakUs, int holdPct,
+                        uint32_t timerHz =defaultHz) {
+        uint32_t period = timerHz / pwmHz;
+        uint32_t n = ((uint64_t) peakUs * pwmHz + 500000) / 1000000;
+        periods = n < 1 ? 1 : n > 256 ? 256 : n;
+        peak = period; //above the reload value, i.e. 100%
+        hold = period * holdPct / 100;
+
+        timer::init(period);
+        timer::output(CH, 0b100); //force inactive, valve closed
+        PIN::mode(Pinmode::alt_out, timer::alt);
+    }
+
+    static void open () { timer::pwmStep(CH, peak, hold, periods); }
+    static void close () { timer::output(CH, 0b100); }
+
+    static uint32_t peak, hold;
+    static int periods;
+};
+
+//Peak-and-hold valve V opened for an exact number of us, as ValvePulse:
+//Timer<TIM> counts the pulse in one-pulse mode, its update interrupt
+//closes the valve. TIM needs no pin, V is set up by its own init()
+//e.g. PeakHoldPulse<PeakHold<1,1,PinA<8>>,5>
+template< typename V, int TIM >
+struct PeakHoldPulse {
+    typedef Timer<TIM> timer;
+
+    //timerHz - input clock of TIM, it is prescaled to 1 MHz
+    static void init (uint32_t timerHz =defaultHz) {
+        timer::init(1, timerHz / 1000000 - 1);
+        Periph::bit(timer::cr1, 0) = 0; // idle until the first pulse
+        Periph::bit(timer::cr1, 3) = 1; // OPM
+        timer::clear();
+        timer::interrupt(end);
+    }
+
+    //Open for us microseconds, starting now
+    static void open (uint32_t us) {
+        if (us == 0)
+            return;
+        Periph::bit(timer::cr1, 0) = 0;
+        MMIO32(timer::cnt) = 0;
+        MMIO32(timer::arr) = us - 1;
+        V::open();
+        Periph::bit(timer::cr1, 0) = 1;
+    }
+
+    //Open now and stay open, until close() or the next pulse
+    static void hold () {
+        Periph::bit(timer::cr1, 0) = 0;
+        V::open();
+    }
+
+    //Held open: close after us more, the drive carries on until then
+    static void closeAfter (uint32_t us) {
+        if (us == 0) {
+            close();
+            return;
+        }
+        Periph::bit(timer::cr1, 0) = 0;
+        MMIO32(timer::cnt) = 0;
+        MMIO32(timer::arr) = us - 1;
+        Periph::bit(timer::cr1, 0) = 1;
+    }
+
+    //Abort a pulse in progress and close the valve now
+    static void close () {
+        Periph::bit(timer::cr1, 0) = 0;
+        V::close();
+    }
+
+    //Pulse in progress
+    static bool busy () { return timer::busy(); }
+
+    static void end () {
+        timer::clear();
+        V::close();
+    }
+};
+
+template< int TIM, int CH, typename PIN >
+uint32_t PeakHold<TIM,CH,PIN>::peak;
+
+template< int TIM, int CH, typename PIN >
+uint32_t PeakHold<TIM,CH,PIN>::hold;
+
+template< int TIM, int CH, typename PIN >
+int PeakHold<TIM,CH,PIN>::periods;
+
+#endif //ECU_DRIVER
@@ -0,0 +1,123 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef ECU_GAINCONSOLE_
+#define ECU_GAINCONSOLE_
+
+#include "../lib/jeeh-fork-master/jee.h"
+#include "../lib/jeeh-fork-master/jee/parse-cmd.h"
+#include "../Control/schedule.h"
+
+//Loads gain schedules over the console, no reflashing. U is any JeeH
+//serial device (UartDev, UartBufDev), replies go through the app's printf
+//  i at kp ki kd p   set point i, Q16 values, decimal or $hex
+//  kp ki kd s        full-scale gains, in thousandths
+//  n u               use points 0..n-1, if their breakpoints rise
+//  l                 list the table in use, in the form it is loaded
+//Edits go to a RAM copy while the loop keeps running on the table in use,
+//u swaps the whole table in at once. Call poll() from the main loop, on
+//a Cascade's gains to retune its position loop in flight
+template< typename U, int N >
+struct GainConsole {
+    typedef GainSchedule<N> Schedule;
+    typedef GainTable<N> Table;
+
+    //Start editing from the table in use
+    static void init (Schedule& s) {
+        staged = 0;
+        ram[0] = *s.table;
+    }
+
+    static void poll (Schedule& s) {
+        while (U::readable())
+            command(s, cmd.parse(U::getc()));
+    }
+
+    static void command (Schedule& s, char c) {
+        Table& t = ram[staged];
+        int const* a = cmd.args;
+        switch (c) {
+            case 'p':
+                if (cmd.argc == 5 && a[0] >= 0 && a[0] < N) {
+                    GainPoint& p = t.point[a[0]];
+                    p.at = a[1];
+                    p.kp = a[2];
+                    p.ki = a[3];
+                    p.kd = a[4];
+                    return;
+                }
+                break;
+            case 's':
+                if (cmd.argc == 3) {
+                    t.kp = a[0] * 0.001f;
+                    t.ki = a[1] * 0.001f;
+                    t.kd = a[2] * 0.001f;
+                    return;
+                }
+                break;
+            case 'u':
+                if (cmd.argc == 1 && a[0] >= 1 && a[0] <= N) {
+                    t.count = a[0];
+                    if (s.use(&t)) {
+                        staged ^= 1;
+                        ram[staged] = t;
+                        printf("ok\n");
+                        return;
+                    }
+                }
+                break;
+            case 'l': {
+                Table const& u = *s.table;
+                printf("%d %d %d s\n", (int) (u.kp * 1000), (int) (u.ki * 1000), (int) (u.kd * 1000));
+                for (int i = 0; i < u.count; ++i)
+                    printf("%d %d %d %d %d p\n", i, u.point[i].at,
+                            u.point[i].kp, u.point[i].ki, u.point[i].kd);
+                printf("%d u\n", u.count);
+                return;
+            }
+            case '?':
+                for (int i = 0; i < cmd.argc; ++i)
+                    printf(" %d", a[i]);
+                printf("\n");
+                return;
+            case 0:
+                return;
+        }
+        printf("?\n");
+    }
+
+    static Command cmd;
+    static Table ram [2];
+    static int staged;
+};
+
+template< typename U, int N >
+Command GainConsole<U,N>::cmd;
+
+template< typename U, int N >
+GainTable<N> GainConsole<U,N>::ram [2];
+
+template< typename U, int N >
+int GainConsole<U,N>::staged;
+
+#endif //ECU_GAINCONSOLE
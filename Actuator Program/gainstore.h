@@ -0,0 +1,122 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef ECU_GAINSTORE_
+#define ECU_GAINSTORE_
+
+#include "../lib/jeeh-fork-master/jee.h"
+#include "../Control/autotune.h"
+
+//Tuned gains kept in one flash sector at ADDR, SIZE bytes long
+//Every save appends a 32-byte record, the last valid record of an axis
+//wins. When the sector is full it is erased and the latest record of
+//each axis is written back first. Programming a record stalls the flash
+//for about 100 us, erasing a 128 KB sector for up to 2 s, so stop the
+//drives first (ActuatorDrive::stop). Keep the sector out of the program
+//image in the linker script, e.g. sector 11 at 0x080E0000 on 1 MB parts
+template< uint32_t ADDR, uint32_t SIZE, int AXES =4 >
+struct GainStore {
+    constexpr static uint32_t magic = 0x54564347; // "GCVT"
+    constexpr static uint32_t acr = Periph::flash + 0x00;
+
+    struct Record {
+        uint32_t magic;
+        uint16_t axis, seq;
+        TunedGains gains;
+        uint32_t check;
+
+        uint32_t sum () const {
+            uint32_t const* w = (uint32_t const*) this;
+            uint32_t s = 0x5A5A5A5A;
+            for (int i = 0; i < 7; ++i)
+                s = ((s << 5) | (s >> 27)) ^ w[i];
+            return s;
+        }
+
+        bool valid () const { return magic == GainStore::magic && check == sum(); }
+    };
+    static_assert(sizeof (Record) == 32, "records are 8 flash words");
+    constexpr static int count = SIZE / sizeof (Record);
+
+    static Record const* records () { return (Record const*) ADDR; }
+
+    //Latest record of an axis, or 0
+    static Record const* find (int axis) {
+        Record const* found = 0;
+        for (int i = 0; i < count && records()[i].magic != 0xFFFFFFFF; ++i)
+            if (records()[i].valid() && records()[i].axis == axis)
+                found = records() + i;
+        return found;
+    }
+
+    static bool load (int axis, TunedGains& gains) {
+        Record const* r = find(axis);
+        if (r != 0)
+            gains = r->gains;
+        return r != 0;
+    }
+
+    //Returns true if the sector had to be erased, i.e. the flash was busy
+    //for seconds rather than 100 us
+    static bool save (int axis, TunedGains const& gains) {
+        int free = 0;
+        while (free < count && records()[free].magic != 0xFFFFFFFF)
+            ++free;
+        Record const* last = find(axis);
+        uint16_t seq = last != 0 ? last->seq + 1 : 0;
+
+        bool erased = free == count;
+        if (erased) {
+            Record keep [AXES];
+            int kept = 0;
+            for (int a = 0; a < AXES; ++a)
+                if (a != axis && (last = find(a)) != 0)
+                    keep[kept++] = *last;
+            Flash::erasePage((void const*) ADDR);
+            for (free = 0; free < kept; ++free)
+                program(free, keep[free]);
+        }
+
+        Record r;
+        r.magic = magic;
+        r.axis = axis;
+        r.seq = seq;
+        r.gains = gains;
+        r.check = r.sum();
+        program(free, r);
+        return erased;
+    }
+
+    static void program (int slot, Record const& r) {
+        Flash::write32buf(records() + slot, (uint32_t const*) &r, 8);
+        //the data cache may still hold the erased words
+        if (Periph::bit(acr, 10)) { // DCEN
+            Periph::bit(acr, 10) = 0;
+            Periph::bit(acr, 12) = 1; // DCRST
+            Periph::bit(acr, 12) = 0;
+            Periph::bit(acr, 10) = 1;
+        }
+    }
+};
+
+#endif //ECU_GAINSTORE
@@ -0,0 +1,131 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef ECU_LOOP_
+#define ECU_LOOP_
+
+#include "../lib/jeeh-fork-master/jee.h"
+
+//Fixed-rate control loop, driven by the update interrupt of Timer<TIM>
+//Every tick runs SENSE -> COMPUTE -> ACTUATE, each phase is timed with DWT
+template< int TIM, uint32_t HZ >
+struct ControlLoop {
+    typedef void (*Phase)();
+    enum { SENSE, COMPUTE, ACTUATE, PHASES };
+
+    //Cycle accounting per phase
+    struct Stats {
+        uint32_t last, peak;
+    };
+
+    //timerHz - input clock of the timer, cpuHz - core clock seen by DWT
+    static void init (Phase sense, Phase compute, Phase actuate,
+                        uint32_t timerHz =defaultHz, uint32_t cpuHz =defaultHz) {
+        phase[SENSE] = sense;
+        phase[COMPUTE] = compute;
+        phase[ACTUATE] = actuate;
+
+        //Whole period is the default deadline, see setDeadline()
+        budget = cpuHz / HZ;
+        deadline = budget;
+        reset();
+        DWT::start();
+
+        Timer<TIM>::initHz(HZ, timerHz);
+        Timer<TIM>::interrupt(tick);
+    }
+
+    //Stop the loop, the timer keeps counting but no longer interrupts
+    static void stop () {
+        Periph::bit(Timer<TIM>::dier, 0) = 0; // UIE
+    }
+
+    //Deadline in cycles for all three phases together
+    static void setDeadline (uint32_t cycles) {
+        deadline = cycles;
+    }
+
+    static void reset () {
+        for (int i = 0; i < PHASES; ++i)
+            stats[i].last = stats[i].peak = 0;
+        ticks = misses = overruns = jitter = 0;
+    }
+
+    //Timer ISR
+    static void tick () {
+        //Counter value at entry is the interrupt latency in timer counts
+        uint32_t late = Timer<TIM>::count();
+        Timer<TIM>::clear();
+        if (late > jitter)
+            jitter = late;
+
+        uint32_t start = DWT::count(), t = start;
+        for (int i = 0; i < PHASES; ++i) {
+            if (phase[i] != 0)
+                phase[i]();
+            uint32_t now = DWT::count();
+            stats[i].last = now - t;
+            if (stats[i].last > stats[i].peak)
+                stats[i].peak = stats[i].last;
+            t = now;
+        }
+
+        if (t - start > deadline)
+            ++misses;
+        //Next update already happened, this tick ran into the next period
+        if (Timer<TIM>::pending())
+            ++overruns;
+        ++ticks;
+    }
+
+    static Phase phase [PHASES];
+    static Stats volatile stats [PHASES];
+    static uint32_t budget, deadline;
+    static uint32_t volatile ticks, misses, overruns, jitter;
+};
+
+template< int TIM, uint32_t HZ >
+typename ControlLoop<TIM,HZ>::Phase ControlLoop<TIM,HZ>::phase [PHASES];
+
+template< int TIM, uint32_t HZ >
+typename ControlLoop<TIM,HZ>::Stats volatile ControlLoop<TIM,HZ>::stats [PHASES];
+
+template< int TIM, uint32_t HZ >
+uint32_t ControlLoop<TIM,HZ>::budget;
+
+template< int TIM, uint32_t HZ >
+uint32_t ControlLoop<TIM,HZ>::deadline;
+
+template< int TIM, uint32_t HZ >
+uint32_t volatile ControlLoop<TIM,HZ>::ticks;
+
+template< int TIM, uint32_t HZ >
+uint32_t volatile ControlLoop<TIM,HZ>::misses;
+
+template< int TIM, uint32_t HZ >
+uint32_t volatile ControlLoop<TIM,HZ>::overruns;
+
+template< int TIM, uint32_t HZ >
+uint32_t volatile ControlLoop<TIM,HZ>::jitter;
+
+#endif //ECU_LOOP
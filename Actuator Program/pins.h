@@ -0,0 +1,51 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef ECU_PINS_
+#define ECU_PINS_
+
+#include "../lib/jeeh-fork-master/jee.h"
+
+//Compile-time pin descriptor for the ECU layer, e.g. EcuPin<'B',3>
+//init() enables the port clock and sets the mode once at startup, after
+//that each write is a single store of a constant to the port's BSRR
+template< char PORT, int PIN, Pinmode MODE =Pinmode::out >
+struct EcuPin : Pin<PORT,PIN> {
+    typedef Pin<PORT,PIN> pin;
+    constexpr static uint32_t bsrr = pin::gpio::bsrr;
+    constexpr static uint32_t set = pin::mask;
+    constexpr static uint32_t reset = (uint32_t) pin::mask << 16;
+
+    static void init () { pin::mode(MODE); }
+
+    static void high () { MMIO32(bsrr) = set; }
+    static void low () { MMIO32(bsrr) = reset; }
+
+    //Branch-free, v must be 0 or 1
+    static void write (int v) { MMIO32(bsrr) = reset >> (16 * v); }
+
+    //shorthand
+    void operator= (int v) const { write(v); }
+};
+
+#endif //ECU_PINS
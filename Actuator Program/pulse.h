@@ -0,0 +1,83 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef ECU_PULSE_
+#define ECU_PULSE_
+
+#include "../lib/jeeh-fork-master/jee.h"
+
+//Valve on a timer channel pin, opened for an exact number of us by the
+//timer in one-pulse mode. Once open() has armed the timer, the hardware
+//drives the pin and ends the pulse, the CPU is not involved at all
+//e.g. ValvePulse<3,1,PinA<6>> is TIM3 channel 1 on PA6
+//Pulses are limited to 65535 us, except on the 32-bit TIM2 and TIM5
+template< int TIM, int CH, typename PIN >
+struct ValvePulse {
+    typedef Timer<TIM> timer;
+
+    //timerHz - input clock of the timer, it is prescaled to 1 MHz
+    static void init (uint32_t timerHz =defaultHz) {
+        timer::init(1, timerHz / 1000000 - 1);
+        Periph::bit(timer::cr1, 0) = 0; // idle until the first pulse
+        timer::output(CH, 0b100); // force inactive, valve closed
+        PIN::mode(Pinmode::alt_out, timer::alt);
+    }
+
+    //Open for us microseconds, starting after us from now (at least 1)
+    static void open (uint32_t us, uint32_t after =1) {
+        if (us > 0)
+            timer::pulse(CH, us, after);
+    }
+
+    //Open now and stay open, until close() or the next pulse
+    static void hold () {
+        Periph::bit(timer::cr1, 0) = 0;
+        timer::output(CH, 0b101);
+    }
+
+    //Held open: close after us more, the pin stays active until then. A
+    //pulse would drop it while the timer waits for its delay
+    static void closeAfter (uint32_t us) {
+        if (us == 0) {
+            close();
+            return;
+        }
+        Periph::bit(timer::cr1, 0) = 0;
+        Periph::bit(timer::cr1, 3) = 1; // OPM
+        MMIO32(timer::cnt) = 0;
+        MMIO32(timer::arr) = us;
+        timer::compare(CH, us, 0b010); // inactive on match
+        Periph::bit(timer::cr1, 0) = 1;
+    }
+
+    //Abort a pulse in progress and close the valve now
+    static void close () {
+        Periph::bit(timer::cr1, 0) = 0;
+        timer::output(CH, 0b100);
+    }
+
+    //Pulse armed or in progress
+    static bool busy () { return timer::busy(); }
+};
+
+#endif //ECU_PULSE
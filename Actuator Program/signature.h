@@ -0,0 +1,237 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef ECU_SIGNATURE_
+#define ECU_SIGNATURE_
+
+#include "../lib/jeeh-fork-master/jee.h"
+
+//Armature motion detector, fed one current sample at a time
+//After an open command the coil current rises until the armature starts
+//to move, back-EMF then makes it dip, and it rises again once the armature
+//is seated. Samples are smoothed by a 4-sample boxcar, peak and dip must
+//stand out by more than the hysteresis. O(1) per sample, no buffers
+struct DipDetector {
+    enum { IDLE, RISING, DIPPING, DONE };
+
+    //hysteresis in ADC counts, window in samples
+    void start (uint16_t hysteresis, uint32_t window) {
+        hyst = 4 * hysteresis;
+        limit = window;
+        n = sum = peak = peakAt = dipAt = 0;
+        hist[0] = hist[1] = hist[2] = hist[3] = 0;
+        low = ~0U;
+        state = RISING;
+    }
+
+    bool active () const { return state == RISING || state == DIPPING; }
+    bool found () const { return state == DONE && dipAt != 0; }
+
+    //Returns true when the event is over, found or not
+    bool feed (uint16_t v) {
+        sum += v - hist[n & 3];
+        hist[n & 3] = v;
+        if (++n < 4)
+            return false;
+
+        if (state == RISING) {
+            if (sum > peak) {
+                peak = sum;
+                peakAt = n;
+            } else if (sum + hyst < peak) {
+                state = DIPPING;
+                low = sum;
+                dipAt = n;
+            }
+        } else if (sum < low) {
+            low = sum;
+            dipAt = n;
+        } else if (sum > low + hyst) {
+            state = DONE;
+            return true;
+        }
+
+        if (n >= limit) {
+            dipAt = 0;
+            state = DONE;
+            return true;
+        }
+        return false;
+    }
+
+    uint16_t hist [4];
+    uint32_t sum, peak, low, hyst;
+    uint32_t n, limit, peakAt, dipAt;
+    uint8_t state = IDLE;
+};
+
+//Per-valve opening latency, from the current signature, in us
+struct SignatureStats {
+    uint32_t events, misses;
+    uint32_t moveUs, seatUs;        //last event: armature starts, seats
+    uint32_t minUs, maxUs, avgUs;   //seat latency, avg is a running 1/8 average
+};
+
+//Solenoid current capture for a valve driven by Timer<TIM>, e.g. PeakHold
+//Channel CH of the same timer sets the sample point in each PWM period and
+//triggers ADC<ADCN> on channel CHAN, DMA fills a ring of SIZE samples and
+//each half is scanned by DipDetector from the DMA interrupt. No CPU work
+//per sample outside that, and none at all between events
+template< int TIM, int CH, int ADCN, int CHAN, int SIZE =64 >
+struct CurrentSignature {
+    typedef Timer<TIM> timer;
+    typedef ADC<ADCN> adc;
+    typedef typename adc::dma dma;
+    constexpr static int extsel = adc::timerEvent(TIM, CH);
+
+    static_assert(extsel >= 0, "this timer channel can't trigger the ADC");
+    static_assert(SIZE % 2 == 0, "DMA ring is processed in halves");
+
+    //samplePoint - timer count within the PWM period to sample at
+    //sampleUs - PWM period, i.e. time between samples
+    //hysteresis - minimum dip depth in ADC counts
+    //windowUs - give up on an event after this long
+    static void init (uint32_t samplePoint, uint32_t sampleUs,
+                        uint16_t hysteresis, uint32_t windowUs) {
+        period = sampleUs;
+        hyst = hysteresis;
+        window = windowUs / sampleUs;
+        stats.minUs = ~0U;
+
+        adc::init();
+        adc::sampleTime(CHAN, 0b011); //56 cycles
+        dma::init(adc::dmaChan, adc::dr, (void const*) buf, SIZE,
+                    dma::circular | dma::memInc | dma::halfWords | dma::high |
+                    dma::irqHalf | dma::irqDone);
+        dma::interrupt(irq);
+        adc::trigger(CHAN, extsel);
+        timer::compare(CH, samplePoint, 0b110);
+    }
+
+    //Open command for the valve has just been issued
+    static void start () {
+        first = SIZE - dma::remaining();
+        if (first >= SIZE)
+            first = 0;
+        pending = true;
+    }
+
+    //Opening latency of the last event found, with the armature half way
+    //between starting to move and seating. Once per event, false if none
+    static bool latency (uint32_t& us) {
+        uint32_t found = stats.events - stats.misses;
+        if (found == taken)
+            return false;
+        taken = found;
+        us = (stats.moveUs + stats.seatUs) / 2;
+        return true;
+    }
+
+    static void irq () {
+        uint32_t f = dma::flags();
+        dma::clear();
+        if (f & dma::halfDone)
+            process(0, SIZE/2);
+        if (f & dma::done)
+            process(SIZE/2, SIZE);
+    }
+
+    static void process (int lo, int hi) {
+        int i = lo;
+        if (pending) {
+            if (first < lo || first >= hi)
+                return;
+            i = first;
+            pending = false;
+            detector.start(hyst, window);
+        }
+        if (!detector.active())
+            return;
+        for (; i < hi; ++i)
+            if (detector.feed(buf[i])) {
+                finish();
+                break;
+            }
+    }
+
+    static void finish () {
+        ++stats.events;
+        if (!detector.found()) {
+            ++stats.misses;
+            return;
+        }
+        //the boxcar is centred 2 samples before the one completing it
+        uint32_t us = (detector.dipAt - 2) * period;
+        stats.moveUs = (detector.peakAt - 2) * period;
+        stats.seatUs = us;
+        if (us < stats.minUs)
+            stats.minUs = us;
+        if (us > stats.maxUs)
+            stats.maxUs = us;
+        stats.avgUs = stats.events - stats.misses == 1 ? us :
+                        stats.avgUs + ((int32_t) (us - stats.avgUs) >> 3);
+    }
+
+    static uint16_t volatile buf [SIZE];
+    static DipDetector detector;
+    static SignatureStats volatile stats;
+    static uint32_t period, window, taken;
+    static uint16_t hyst;
+    static int first;
+    static bool volatile pending;
+};
+
+template< int TIM, int CH, int ADCN, int CHAN, int SIZE >
+uint16_t volatile CurrentSignature<TIM,CH,ADCN,CHAN,SIZE>::buf [SIZE];
+
+template< int TIM, int CH, int ADCN, int CHAN, int SIZE >
+DipDetector CurrentSignature<TIM,CH,ADCN,CHAN,SIZE>::detector;
+
+template< int TIM, int CH, int ADCN, int CHAN, int SIZE >
+SignatureStats volatile CurrentSignature<TIM,CH,ADCN,CHAN,SIZE>::stats;
+
+template< int TIM, int CH, int ADCN, int CHAN, int SIZE >
+uint32_t CurrentSignature<TIM,CH,ADCN,CHAN,SIZE>::period;
+
+template< int TIM, int CH, int ADCN, int CHAN, int SIZE >
+uint32_t CurrentSignature<TIM,CH,ADCN,CHAN,SIZE>::window;
+
+template< int TIM, int CH, int ADCN, int CHAN, int SIZE >
+uint32_t CurrentSignature<TIM,CH,ADCN,CHAN,SIZE>::taken;
+
+template< int TIM, int CH, int ADCN, int CHAN, int SIZE >
+uint16_t CurrentSignature<TIM,CH,ADCN,CHAN,SIZE>::hyst;
+
+template< int TIM, int CH, int ADCN, int CHAN, int SIZE >
+int CurrentSignature<TIM,CH,ADCN,CHAN,SIZE>::first;
+
+template< int TIM, int CH, int ADCN, int CHAN, int SIZE >
+bool volatile CurrentSignature<TIM,CH,ADCN,CHAN,SIZE>::pending;
+
+//Stand-in for a valve without coil current sensing
+struct NoSignature {
+    static void start () {}
+    static bool latency (uint32_t&) { return false; }
+};
+
+#endif //ECU_SIGNATURE
@@ -1,14 +1,134 @@
 #include"../lib/jeeh-fork-master/jee.h"
 #include"GPIO.h"
+#include"loop.h"
+#include"pins.h"
+#include"driver.h"
+#include"signature.h"
+#include"valveloop.h"
+#ifdef GPIO_BENCH
+#include"bench.h"
+#endif
 
 //Definitions
 // PIN 
 #define PIN_LOC 0
+//Control loop rate (Hz) and the timer driving it
+#define LOOP_HZ 2000
+#define LOOP_TIMER 2
+//TIM2 sits on APB1, which runs timers at half the 168 MHz core clock
+#define LOOP_TIMER_HZ 84000000
+//Valve pulses on TIM5 channel 1 (PA0), also on APB1. The flow of each
+//20 ms period is planned from the entry flow and sent as one pulse
+#define VALVE_TIMER 5
+#define VALVE_TIMER_HZ 84000000
+#define VALVE_PERIOD_US 20000
+//Desired flow in entry flow counts, at or above the entry flow the valve
+//is held open
+#define DESIRED_FLOW 0xFFFF
+//Peak-and-hold drive (build with -DVALVE_PEAK_HOLD), TIM1 runs at 168 MHz
+//The valve is then pulsed on TIM1, still timed by VALVE_TIMER. Pull-in
+//outlasts the valve response, so the current only drops to hold once the
+//armature is seated and the current signature is complete
+#define VALVE_PWM_HZ 20000
+#define VALVE_PEAK_US 6000
+#define VALVE_HOLD_PCT 30
+//Coil current sense on ADC2 channel 10 (PC0), sampled by TIM1 channel 2
+#define VALVE_CURRENT_ADC 2
+#define VALVE_CURRENT_CHAN 10
+#define VALVE_CURRENT_HYST 8
+#define VALVE_CURRENT_WINDOW_US 20000
+//Loop inputs, scanned continuously on ADC1: entry flow sensor on PA1
+//(channel 1), supply divider on PA2 (channel 2), the chip's temperature
+//sensor and VREFINT. The longest sampling time suits the sensor
+//impedance, and the internal channels need over 10 us, it costs the loop
+//nothing
+#define SCAN_ADC 1
+#define SCAN_SAMPLE 0b111
+//Slow sensors, oversampled on ADC3 and decimated to 16 bits: chamber
+//pressure on PA3 (channel 3), temperature on PC1 (channel 11). A frame of
+//both takes 46.9 us at the longest sampling time, 64 frames per block,
+//boxcar of 16, FIR decimating by 4: 333 samples per second, 6 ms delay
+#define SLOW_ADC 3
+#define SLOW_FRAMES 64
+#define SLOW_BOXCAR 16
+#define SLOW_DECIMATE 4
+//Sensor lines, see SensorBank: supply divider 11:1 (mV), chamber pressure
+//0 to 1000 kPa at 10 to 90 % of VDDA, ratiometric (Pa), thermocouple
+//amplifier at 5 mV per C from 0 C (thousandths of a degree)
+#define SUPPLY_DIVIDER 11
+#define CHAMBER_KPA 1000
+#define THERMO_MV_PER_C 5
+//Loop ticks between refreshes of the cached supply from VREFINT
+#define VREF_REFRESH_TICKS 200
+//Valve response time (us) from Control/cfg.txt, refined online
+#define VALVE_RESPONSE_US 5000
+#define VALVE_RESPONSE_LIMIT_US 50000
+
+typedef ControlLoop<LOOP_TIMER,LOOP_HZ> Loop;
+//Valve output pin, as a GPIO for the write benchmark
+typedef EcuPin<'A',PIN_LOC> ValvePin;
+
+//High performance valve, TIM1 channel 1 on PA8
+typedef PeakHold<1,1,PinA<8>> PeakHoldValve;
+//Its opening latency from the coil current signature
+typedef CurrentSignature<1,2,VALVE_CURRENT_ADC,VALVE_CURRENT_CHAN> PeakHoldCurrent;
+
+//The board as the valve loop sees it, see valveloop.h
+struct ValveBoard {
+#ifdef VALVE_PEAK_HOLD
+    //The peak-and-hold valve, its current signature refines the latency
+    typedef PeakHoldPulse<PeakHoldValve,VALVE_TIMER> valve;
+    typedef PeakHoldCurrent signature;
+#else
+    //The valve, pulsed by its timer on ValvePin
+    typedef ValvePulse<VALVE_TIMER,1,PinA<PIN_LOC>> valve;
+    typedef NoSignature signature;
+#endif
+    //Its position switch
+    typedef PinB<0> feedback;
+    enum { valveTimerHz = VALVE_TIMER_HZ, loopHz = LOOP_HZ, periodUs = VALVE_PERIOD_US,
+           scanAdc = SCAN_ADC, scanSample = SCAN_SAMPLE, entryChan = 1, supplyChan = 2,
+           slowAdc = SLOW_ADC, slowFrames = SLOW_FRAMES, slowBoxcar = SLOW_BOXCAR,
+           slowDecimate = SLOW_DECIMATE, pressureChan = 3, temperatureChan = 11,
+           supplyDivider = SUPPLY_DIVIDER, chamberKpa = CHAMBER_KPA,
+           thermoMvPerC = THERMO_MV_PER_C, vrefRefreshTicks = VREF_REFRESH_TICKS,
+           responseUs = VALVE_RESPONSE_US, responseLimitUs = VALVE_RESPONSE_LIMIT_US };
+};
+typedef ValveLoop<ValveBoard> Program;
+
+#ifdef GPIO_BENCH
+//Cycles per valve write, inspect with the debugger
+uint32_t benchSpl, benchBsrr;
+#endif
+
+uint8_t (valveState)(uint8_t valvePin, uint8_t state);
+uint8_t (valvePeakHold)(uint8_t state);
 
 int main(){
-    //Call component driver function 
-    //Set valve to valve state (OUT)
-    valveState(PIN_LOC,OUT);
+    int hz = fullSpeedClock();
+    //Entry flow, supply, chamber pressure, temperature
+    PinA<1>::mode(Pinmode::in_analog);
+    PinA<2>::mode(Pinmode::in_analog);
+    PinA<3>::mode(Pinmode::in_analog);
+    PinC<1>::mode(Pinmode::in_analog);
+#ifdef GPIO_BENCH
+    //Before the valve timer takes the pin over
+    BENCH_ECU_GPIO<ValvePin>(&benchSpl,&benchBsrr);
+#endif
+    Program::init(hz);
+    Program::desired = DESIRED_FLOW;
+#ifdef VALVE_PEAK_HOLD
+    PeakHoldValve::init(VALVE_PWM_HZ,VALVE_PEAK_US,VALVE_HOLD_PCT,hz);
+    //Sample halfway through the on-time of the hold phase
+    PinC<0>::mode(Pinmode::in_analog);
+    PeakHoldCurrent::init(PeakHoldValve::hold / 2,1000000 / VALVE_PWM_HZ,
+                            VALVE_CURRENT_HYST,VALVE_CURRENT_WINDOW_US);
+#endif
+    //Run component driver from the fixed rate loop
+    Loop::init(Program::sense,Program::compute,Program::actuate,LOOP_TIMER_HZ,hz);
+    while(1){
+        //Idle, everything happens in the loop interrupt
+    }
     return 0;
 }
 
@@ -20,8 +140,25 @@ uint8_t (valveState)(uint8_t valvePin, uint8_t state){
     switch(state){
         case OUT:
             SET_ECU_GPIO_HIGH(valvePin,CLOCK_A); //<- Assume CLOCK PORT A - CHANGE
+            break;
         case IN:
             SET_ECU_GPIO_LOW(valvePin,CLOCK_A); //<- Assume CLOCK PORT A - CHANGE
+            break;
+    }
+    return 0;
+}
+
+//Component driver for peak-and-hold solenoid valve (Open, close)
+//Same states as valveState(), the coil current is shaped by TIM1
+uint8_t (valvePeakHold)(uint8_t state){
+    switch(state){
+        case OUT:
+            PeakHoldValve::open();
+            PeakHoldCurrent::start();
+            break;
+        case IN:
+            PeakHoldValve::close();
+            break;
     }
     return 0;
 }
@@ -0,0 +1,89 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef ECU_VALVEBANK_
+#define ECU_VALVEBANK_
+
+#include "../lib/jeeh-fork-master/jee.h"
+
+//Helpers, evaluated at compile time for the constant pin ids of a bank
+
+//Ports used by a list of pin ids, bit 0 = port A
+constexpr uint16_t bankPorts () { return 0; }
+template< typename... R >
+constexpr uint16_t bankPorts (int id, R... rest) {
+    return (1 << (id >> 4)) | bankPorts(rest...);
+}
+
+constexpr int bankBits (uint32_t m) { return m ? (m & 1) + bankBits(m >> 1) : 0; }
+
+//Index of the n-th port set in used
+constexpr int bankNthPort (uint16_t used, int n, int k =0) {
+    return (used >> k) & 1 ? (n == 0 ? k : bankNthPort(used, n - 1, k + 1))
+                           : bankNthPort(used, n, k + 1);
+}
+
+//BSRR word for one port, valve i drives pin id
+constexpr uint32_t bankWord (int, uint32_t, uint32_t, int) { return 0; }
+template< typename... R >
+constexpr uint32_t bankWord (int port, uint32_t open, uint32_t close, int i, int id, R... rest) {
+    return ((id >> 4) == port ? (((open >> i) & 1) << (id & 15)) |
+                                (((close >> i) & 1) << ((id & 15) + 16)) : 0) |
+           bankWord(port, open, close, i + 1, rest...);
+}
+
+//Bank of valves on any mix of pins, e.g. ValveBank<PinA<0>,PinA<1>,PinB<4>>
+//Valve i is bit i of the open/close masks. All words are computed before
+//the first store, so a bank on one port changes in a single BSRR write and
+//a bank spanning ports uses one back-to-back write per port (skew is
+//stores-1 bus writes). A valve in both masks opens, as set wins in BSRR
+template< typename... V >
+struct ValveBank {
+    constexpr static int count = sizeof...(V);
+    constexpr static uint32_t all = count < 32 ? (1U << count) - 1 : ~0U;
+    constexpr static uint16_t ports = bankPorts(V::id...);
+    constexpr static int stores = bankBits(ports);
+
+    static_assert(count <= 32, "valve masks are 32 bits");
+
+    static void init () {
+        int dummy [] = { (V::mode(Pinmode::out), 0)... };
+        (void) dummy;
+    }
+
+    static void commit (uint32_t open, uint32_t close) {
+        uint32_t word [stores];
+        for (int k = 0; k < stores; ++k)
+            word[k] = bankWord(bankNthPort(ports, k), open, close, 0, V::id...);
+        for (int k = 0; k < stores; ++k)
+            MMIO32(Port<'A'>::bsrr + 0x400 * bankNthPort(ports, k)) = word[k];
+    }
+
+    static void open (uint32_t mask) { commit(mask, 0); }
+    static void close (uint32_t mask) { commit(0, mask); }
+
+    //Set every valve in the bank, 1 = open
+    static void write (uint32_t state) { commit(state, ~state & all); }
+};
+
+#endif //ECU_VALVEBANK
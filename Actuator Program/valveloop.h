@@ -0,0 +1,243 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+#ifndef ECU_VALVELOOP_
+#define ECU_VALVELOOP_
+
+#include "../lib/jeeh-fork-master/jee.h"
+#include "../Control/decimate.h"
+#include "../Control/planner.h"
+#include "../Control/sensor.h"
+#include "adcblocks.h"
+#include "adcscan.h"
+#include "deadtime.h"
+#include "pulse.h"
+#include "signature.h"
+
+//The valve program: sense(), compute() and actuate() for ControlLoop and
+//the set-up of all they use, run by valve.c on the ECU and by
+//Host/sim_valve.cpp on the simulator. C describes the board:
+//  valve - ValvePulse driving the valve, on a timer clocked at valveTimerHz
+//  feedback - position switch of the valve, interrupts on both edges
+//  signature - CurrentSignature of the valve's coil, or NoSignature. Its
+//      opening latencies go into the DeadTime estimates with the switch's
+//  loopHz, periodUs - loop rate, and the valve period, a whole number of
+//      loop ticks: the flow of each period is planned from the entry flow
+//      and delivered as one timed pulse, see compute() and actuate()
+//  scanAdc, scanSample - loop inputs, scanned continuously: entryChan
+//      (entry flow), supplyChan (supply divider), the chip's temperature
+//      sensor and VREFINT. Internal channels need over 10 us of sampling
+//  slowAdc, slowFrames, slowBoxcar, slowDecimate - slow sensors
+//      oversampled and decimated to 16 bits, see Decimator: pressureChan
+//      (chamber pressure), temperatureChan (thermocouple amplifier)
+//  supplyDivider, chamberKpa, thermoMvPerC - sensor scaling, see sense()
+//  vrefRefreshTicks - loop ticks between refreshes of the cached supply
+//  responseUs, responseLimitUs - valve response time from Control/cfg.txt
+//      as the start of the DeadTime estimates, and the longest one taken
+//The analog pins are set up by the caller
+template< typename C >
+struct ValveLoop {
+    typedef typename C::valve Valve;
+    typedef typename C::signature Signature;
+    typedef AdcScan<C::scanAdc> Inputs;
+    enum { ENTRY_FLOW, SUPPLY, CHIP_TEMP, VREFINT, INPUTS };
+    enum { CHAMBER_PRESSURE, TEMPERATURE, SLOW };
+    typedef AdcBlocks<C::slowAdc,SLOW,C::slowFrames> SlowInputs;
+    enum { SENSE_SUPPLY, SENSE_CHIP, SENSE_PRESSURE, SENSE_TEMPERATURE, SENSES };
+    enum { periodTicks = (uint64_t) C::periodUs * C::loopHz / 1000000 };
+    static_assert((uint64_t) periodTicks * 1000000 == (uint64_t) C::periodUs * C::loopHz,
+                  "the valve period must be a whole number of loop ticks");
+
+    //hz - core clock, DeadTime counts DWT cycles
+    static void init (uint32_t hz) {
+        static const uint8_t inputChannels [INPUTS] = {
+            C::entryChan, C::supplyChan, ADC<C::scanAdc>::tempChan, ADC<C::scanAdc>::vrefChan };
+        static const uint8_t slowChannels [SLOW] = { C::pressureChan, C::temperatureChan };
+        //Hamming-windowed sinc cut off at 0.1 of the boxcar rate, unity
+        //gain, -49 dB from the first alias band on
+        static const q15_t slowTaps [16] = { -114, -159, -139, 291, 1450, 3284, 5246, 6525,
+                                             6525, 5246, 3284, 1450, 291, -139, -159, -114 };
+        Valve::init(C::valveTimerHz);
+        deadTime.init(hz, C::responseUs, C::responseLimitUs);
+        C::feedback::mode(Pinmode::in_pullup);
+        Inputs::init(inputChannels, INPUTS, C::scanSample);
+        //supply divider (mV), chamber pressure at 10 to 90 % of VDDA,
+        //ratiometric (Pa), thermocouple amplifier from 0 C (thousandths
+        //of a degree)
+        sensors.init(3300, vrefint_cal);
+        sensors.line(SENSE_SUPPLY, 0, 0, 4095, 3300 * C::supplyDivider, true);
+        sensors.chipTemperature(SENSE_CHIP, temp_30, temp_110);
+        sensors.line(SENSE_PRESSURE, 410, 0, 3686, C::chamberKpa * 1000, false, 16);
+        sensors.line(SENSE_TEMPERATURE, 0, 0, 4095, 3300 * 1000 / C::thermoMvPerC, true, 16);
+        for (int i = 0; i < SLOW; ++i)
+            slowFilters[i].init(C::slowDecimate, slowTaps);
+        SlowInputs::init(slowChannels, filterSlow, C::scanSample);
+        Exti<typename C::feedback>::init([]() {
+            Exti<typename C::feedback>::clear();
+            deadTime.moved(0);
+        });
+    }
+
+    //One block of slow input frames, at most one output per channel
+    static void filterSlow (uint16_t const* frames, int count) {
+        for (int i = 0; i < SLOW; ++i) {
+            uint16_t out [C::slowFrames / (C::slowBoxcar * C::slowDecimate) + 1];
+            int n = slowFilters[i].process(frames + i, SLOW, count, out);
+            if (n > 0)
+                slowLatest[i] = out[n - 1];
+        }
+    }
+
+    //Read inputs for this tick
+    static void sense () {
+        Inputs::read(inputs);
+        for (int i = 0; i < SLOW; ++i)
+            slow[i] = slowLatest[i];
+        if (++sinceRefresh >= C::vrefRefreshTicks) {
+            sinceRefresh = 0;
+            sensors.refresh(inputs[VREFINT]);
+        }
+        units[SENSE_SUPPLY] = sensors.read(SENSE_SUPPLY, inputs[SUPPLY]);
+        units[SENSE_CHIP] = sensors.read(SENSE_CHIP, inputs[CHIP_TEMP]);
+        units[SENSE_PRESSURE] = sensors.read(SENSE_PRESSURE, slow[CHAMBER_PRESSURE]);
+        units[SENSE_TEMPERATURE] = sensors.read(SENSE_TEMPERATURE, slow[TEMPERATURE]);
+        uint32_t us;
+        if (Signature::latency(us))
+            deadTime.measured(0, true, us);
+    }
+
+    //Plan the flow time of the next valve period, once per period: short
+    //pulses are held back by the measured response time
+    static void compute () {
+        if (++phase < periodTicks)
+            return;
+        phase = 0;
+        flowUs = planner.plan(inputs[ENTRY_FLOW], deadTime.response(0), desired).open;
+        due = true;
+    }
+
+    //Start the planned period: closed, held open, or a pulse timed by the
+    //hardware and corrected for the measured latencies, so that the valve
+    //passes flow for flowUs
+    static void actuate () {
+        if (!due)
+            return;
+        due = false;
+        if (flowUs == 0) {
+            if (held) {
+                Valve::close();
+                deadTime.command(0, false);
+            }
+            held = false;
+        } else if (flowUs >= C::periodUs) {
+            if (!held) {
+                Valve::hold();
+                deadTime.command(0, true);
+                Signature::start();
+            }
+            held = true;
+        } else if (held) {
+            //still open from the held period, flow lasts until the close
+            //takes effect. Nothing to time, the valve never closed
+            uint32_t close = deadTime.closeUs(0);
+            widthUs = flowUs > close ? flowUs - close : 0;
+            Valve::closeAfter(widthUs);
+            held = false;
+        } else {
+            widthUs = deadTime.width(0, flowUs);
+            Valve::open(widthUs);
+            deadTime.pulse(0, widthUs);
+            Signature::start();
+        }
+    }
+
+    //Desired flow, in entry flow counts, at or above the entry flow the
+    //valve stays open. Written by the application at any time
+    static uint16_t volatile desired;
+    //Flow time of this period and the commanded pulse width, in us
+    static uint32_t flowUs, widthUs;
+    static FlowPlanner<C::periodUs> planner;
+    static int phase;
+    static bool due, held;
+    //Measured valve response times
+    static DeadTime<1> deadTime;
+    //Analog inputs, the last complete scan as of this tick
+    static uint16_t inputs [INPUTS];
+    //Slow inputs, filtered a block at a time from the DMA interrupt, the
+    //latest 16-bit samples (whole halfword writes) and the loop's copy
+    static Decimator<16,C::slowBoxcar,C::slowFrames / C::slowBoxcar> slowFilters [SLOW];
+    static uint16_t volatile slowLatest [SLOW];
+    static uint16_t slow [SLOW];
+    //Inputs in units, integer conversions against the cached supply
+    static SensorBank<SENSES> sensors;
+    static int32_t units [SENSES];
+    static int sinceRefresh;
+};
+
+template< typename C >
+uint16_t volatile ValveLoop<C>::desired;
+
+template< typename C >
+uint32_t ValveLoop<C>::flowUs;
+
+template< typename C >
+uint32_t ValveLoop<C>::widthUs;
+
+template< typename C >
+FlowPlanner<C::periodUs> ValveLoop<C>::planner;
+
+template< typename C >
+int ValveLoop<C>::phase;
+
+template< typename C >
+bool ValveLoop<C>::due;
+
+template< typename C >
+bool ValveLoop<C>::held;
+
+template< typename C >
+DeadTime<1> ValveLoop<C>::deadTime;
+
+template< typename C >
+uint16_t ValveLoop<C>::inputs [INPUTS];
+
+template< typename C >
+Decimator<16,C::slowBoxcar,C::slowFrames / C::slowBoxcar> ValveLoop<C>::slowFilters [SLOW];
+
+template< typename C >
+uint16_t volatile ValveLoop<C>::slowLatest [SLOW];
+
+template< typename C >
+uint16_t ValveLoop<C>::slow [SLOW];
+
+template< typename C >
+SensorBank<ValveLoop<C>::SENSES> ValveLoop<C>::sensors;
+
+template< typename C >
+int32_t ValveLoop<C>::units [SENSES];
+
+template< typename C >
+int ValveLoop<C>::sinceRefresh;
+
+#endif //ECU_VALVELOOP
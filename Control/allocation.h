@@ -0,0 +1,179 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef CONTROL_ALLOCATION_
+#define CONTROL_ALLOCATION_
+
+#include "kinematics.h"
+
+//Saturation-aware allocation of gimbal commands to the two actuators
+//Clamping each actuator on its own turns the thrust vector whenever one
+//of them saturates. Instead the command is scaled towards the centre until
+//both actuators can reach it, and the step from the present angles is
+//scaled down until both can make it within their speed. Direction is kept,
+//magnitude gives way.
+//
+//Reach is a polygon in angle space, built by the compiler: along evenly
+//spaced directions the distance to the nearest stroke or deflection limit
+//is found by bisection. Where the limit that binds changes between two
+//directions, the corner is found by bisection too and gets a vertex of
+//its own. Each edge is stored as its outward normal over its distance
+//from 0,0, so for a command c the largest normal.c is the factor it
+//overshoots by: a tick is EDGES multiply-adds, whatever the command.
+//Speed uses the Jacobian at 0,0, within a few percent over the whole
+//deflection range
+
+template< typename G, int EDGES >
+struct FeasiblePolygon {
+    constexpr static int spokes = EDGES * 3 / 4;    //the rest for corners
+
+    float edge [EDGES][2];  //pitch, yaw of normal / distance, inside <= 1
+    float radius [EDGES];   //distance of each vertex from 0,0
+    int count;              //edges used
+
+    //Limit that p, y lies beyond: 0..3 stroke, 4..7 deflection, or -1
+    constexpr static int beyond (double p, double y) {
+        ActuatorLengths l = gimbalLengths<G,ConstMath>(p, y);
+        return l.a < G::length - G::stroke ? 0 : l.a > G::length + G::stroke ? 1 :
+               l.b < G::length - G::stroke ? 2 : l.b > G::length + G::stroke ? 3 :
+               p < -G::limit ? 4 : p > G::limit ? 5 :
+               y < -G::limit ? 6 : y > G::limit ? 7 : -1;
+    }
+
+    //Distance to the boundary in direction t, and the limit found there
+    constexpr static double reach (double t, int& limit) {
+        double c = ConstMath::cos(t), s = ConstMath::sin(t);
+        double lo = 0, hi = 2 * G::limit;
+        for (int i = 0; i < 40; ++i) {
+            double mid = (lo + hi) / 2;
+            if (beyond(mid * c, mid * s) < 0)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        limit = beyond(hi * c, hi * s);
+        return lo;
+    }
+
+    constexpr FeasiblePolygon () : edge (), radius (), count (0) {
+        constexpr double pi = 3.14159265358979324;
+        double angle [EDGES] {};
+        int limit [spokes] {};
+        for (int k = 0; k < spokes; ++k)
+            reach(2 * pi * k / spokes, limit[k]);
+
+        for (int k = 0; k < spokes; ++k) {
+            double t0 = 2 * pi * k / spokes, t1 = 2 * pi * (k + 1) / spokes;
+            angle[count++] = t0;
+            if (limit[k] != limit[(k + 1) % spokes] && count < EDGES - (spokes - 1 - k)) {
+                double a = t0, b = t1;
+                for (int i = 0; i < 40; ++i) {
+                    int l = 0;
+                    reach((a + b) / 2, l);
+                    (l == limit[k] ? a : b) = (a + b) / 2;
+                }
+                //a corner right on a spoke would make a zero length edge
+                if (a - t0 > 1e-6 && t1 - a > 1e-6)
+                    angle[count++] = a;
+            }
+        }
+
+        double x [EDGES] {}, y [EDGES] {};
+        for (int k = 0; k < count; ++k) {
+            int l = 0;
+            radius[k] = reach(angle[k], l);
+            x[k] = radius[k] * ConstMath::cos(angle[k]);
+            y[k] = radius[k] * ConstMath::sin(angle[k]);
+        }
+        for (int k = 0; k < count; ++k) {
+            int n = (k + 1) % count;
+            double nx = y[n] - y[k], ny = x[k] - x[n];
+            double d = nx * x[k] + ny * y[k];
+            edge[k][0] = nx / d;
+            edge[k][1] = ny / d;
+        }
+    }
+};
+
+template< typename G =BellGimbal, int EDGES =32 >
+struct Allocator {
+    enum { STROKE = 1, SPEED = 2 };
+
+    //rate - actuator speed limit in metres per tick
+    void init (float rate) {
+        invRate = 1 / rate;
+        limited = 0;
+    }
+
+    void reset (GimbalAngles g) { at = g; }
+
+    //How far outside the reachable set g is, <= 1 inside
+    static float overshoot (GimbalAngles g) {
+        float s = 0;
+        for (int k = 0; k < polygon.count; ++k) {
+            float d = polygon.edge[k][0] * g.pitch + polygon.edge[k][1] * g.yaw;
+            s = d > s ? d : s;
+        }
+        return s;
+    }
+
+    //Next angles towards the command, limits hit are flagged in limited
+    GimbalAngles update (GimbalAngles cmd) {
+        limited = 0;
+        float s = overshoot(cmd);
+        if (s > 1) {
+            float k = 1 / s;
+            cmd.pitch *= k;
+            cmd.yaw *= k;
+            limited |= STROKE;
+        }
+
+        typedef Kinematics<G> K;
+        float dp = cmd.pitch - at.pitch, dy = cmd.yaw - at.yaw;
+        float da = K::jacobian.fwd[0][0] * dp + K::jacobian.fwd[0][1] * dy;
+        float db = K::jacobian.fwd[1][0] * dp + K::jacobian.fwd[1][1] * dy;
+        da = da < 0 ? -da : da;
+        db = db < 0 ? -db : db;
+        float m = (da > db ? da : db) * invRate;
+        if (m > 1) {
+            float k = 1 / m;
+            dp *= k;
+            dy *= k;
+            limited |= SPEED;
+        }
+        at.pitch += dp;
+        at.yaw += dy;
+        return at;
+    }
+
+    GimbalAngles at {};
+    float invRate;
+    uint8_t limited;
+
+    constexpr static FeasiblePolygon<G,EDGES> polygon {};
+};
+
+template< typename G, int EDGES >
+constexpr FeasiblePolygon<G,EDGES> Allocator<G,EDGES>::polygon;
+
+#endif //CONTROL_ALLOCATION
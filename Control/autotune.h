@@ -0,0 +1,156 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef CONTROL_AUTOTUNE_
+#define CONTROL_AUTOTUNE_
+
+#include <math.h>
+#include <stdint.h>
+
+//Relay-feedback auto-tuning (Astrom-Hagglund)
+//While running, the loop output is a relay: bias + amplitude when the
+//error is above +hysteresis, bias - amplitude below -hysteresis. Most
+//plants then settle into a limit cycle at their ultimate frequency. Each
+//period is timed in ticks and its peak-to-peak swing is tracked, after
+//"settle" periods the next "cycles" are averaged. Per tick that is a few
+//compares and adds, the gains are worked out once at the end:
+//  ultimate gain Ku = 4 amplitude / (pi sqrt(a^2 - hysteresis^2))
+//  ultimate period Tu, a = half the peak-to-peak swing
+//Gains come out per sample, as Pid::init() takes them
+struct TunedGains {
+    float kp, ki, kd;   //per sample
+    float ku, tu;       //ultimate gain, ultimate period in ticks
+};
+
+struct RelayTune {
+    enum State { IDLE, RUNNING, DONE, FAILED };
+    enum Rule {
+        ZN_PID,         //Ziegler-Nichols: 0.6 Ku, Ti = Tu/2, Td = Tu/8
+        ZN_PI,          //Ziegler-Nichols: 0.45 Ku, Ti = Tu/1.2
+        MARGIN_PID,     //Astrom-Hagglund, 45 deg phase margin, Td = Ti/4
+    };
+
+    //limit - give up after this many ticks without a full period
+    void start (float amplitude, float hysteresis, float bias, Rule rule,
+                int settle =2, int cycles =4, uint32_t limit =20000) {
+        this->amplitude = amplitude;
+        this->hysteresis = hysteresis;
+        this->bias = bias;
+        this->rule = rule;
+        this->settle = settle;
+        this->cycles = cycles;
+        this->limit = limit;
+        high = true;
+        tick = rise = 0;
+        periods = 0;
+        sumTicks = 0;
+        sumSwing = 0;
+        lo = 1e30f;
+        hi = -1e30f;
+        __asm volatile ("" ::: "memory");
+        state = RUNNING;
+    }
+
+    void stop () { state = IDLE; }
+
+    bool running () const { return state == RUNNING; }
+
+    //One tick of the loop, returns the relay output
+    float update (float setpoint, float measurement) {
+        float e = setpoint - measurement;
+        ++tick;
+        if (measurement < lo)
+            lo = measurement;
+        if (measurement > hi)
+            hi = measurement;
+
+        if (high && e < -hysteresis)
+            high = false;
+        else if (!high && e > hysteresis) {
+            //one full period since the last rising switch
+            high = true;
+            if (rise != 0 && ++periods > settle) {
+                sumTicks += tick - rise;
+                sumSwing += hi - lo;
+                if (periods == settle + cycles)
+                    finish();
+            }
+            rise = tick;
+            lo = 1e30f;
+            hi = -1e30f;
+        }
+        if (tick - rise > limit)
+            state = FAILED;
+        return high ? bias + amplitude : bias - amplitude;
+    }
+
+    void finish () {
+        float a = sumSwing / (2 * cycles);
+        float tu = (float) sumTicks / cycles;
+        float r = a * a - hysteresis * hysteresis;
+        if (r <= 0 || tu < 4) {
+            state = FAILED;
+            return;
+        }
+        result.ku = 4 * amplitude / (float) (M_PI * sqrtf(r));
+        result.tu = tu;
+
+        float kp, ti, td;
+        switch (rule) {
+            case ZN_PI:
+                kp = 0.45f * result.ku;
+                ti = tu / 1.2f;
+                td = 0;
+                break;
+            case MARGIN_PID: {
+                //put the ultimate point on the unit circle, 45 deg from -1
+                const float phi = (float) M_PI / 4, t = tanf(phi), alpha = 0.25f;
+                float wu = 2 * (float) M_PI / tu;
+                kp = result.ku * cosf(phi);
+                ti = (t + sqrtf(t * t + 4 * alpha)) / (2 * alpha * wu);
+                td = alpha * ti;
+                break;
+            }
+            default:
+                kp = 0.6f * result.ku;
+                ti = tu / 2;
+                td = tu / 8;
+        }
+        result.kp = kp;
+        result.ki = kp / ti;
+        result.kd = kp * td;
+        __asm volatile ("" ::: "memory");
+        state = DONE;
+    }
+
+    TunedGains result;
+    State volatile state = IDLE;
+
+    float amplitude, hysteresis, bias, lo, hi, sumSwing;
+    Rule rule;
+    int settle, cycles, periods;
+    uint32_t tick, rise, limit, sumTicks;
+    bool high;
+};
+
+#endif //CONTROL_AUTOTUNE
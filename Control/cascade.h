@@ -0,0 +1,206 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef CONTROL_CASCADE_
+#define CONTROL_CASCADE_
+
+#include "pid.h"
+#include "slot.h"
+#include "autotune.h"
+#include "kalman.h"
+#include "mpc.h"
+#include "schedule.h"
+#include "stall.h"
+
+//Cascaded actuator control: position -> velocity -> current -> drive
+//Each loop runs from its own interrupt at its own rate, setpoints flow
+//inward and measurements outward through Slots, so a slow loop never
+//holds up a fast one. The velocity loop samples position and derives
+//velocity from it, smoothed differences or a Kalman filter, the position
+//loop only sees the published values
+struct Cascade {
+    constexpr static int SchedulePoints = 8;    //gain schedule table size
+
+    //velocityHz - rate of velocityTick(), filter - velocity smoothing 0..1
+    void init (float32_t velocityHz, float32_t filter) {
+        rate = velocityHz;
+        alpha = filter;
+        lastPos = vel = 0;
+        kalman = false;
+        watching = false;
+        stall.clear();
+        mpc.table = 0;
+        scheduled = false;
+        amps = duty = 0;
+    }
+
+    //Watch for a jammed or open actuator in the velocity loop, see
+    //StallDetector for the arguments. The fault is in stall.fault
+    void watch (float32_t latchMs, float32_t effortAmps, float32_t travel,
+                float32_t openDuty =0.8f) {
+        stall.init(rate, latchMs, effortAmps, travel, openDuty);
+        watching = true;
+    }
+
+    //Estimate position and velocity with a steady-state Kalman filter
+    //instead, posNoise in m, accelNoise the unmodelled acceleration m/s^2,
+    //perAmp the acceleration per A of current setpoint, 0 if unknown
+    void track (float32_t posNoise, float32_t accelNoise, float32_t perAmp =0) {
+        tracker.init(rate, posNoise, accelNoise, perAmp, lastPos);
+        kalman = true;
+    }
+
+    //Tune the position loop by relay feedback around the present target:
+    //the position PID is replaced by a relay of +/-speed (m/s) until the
+    //limit cycle has been measured, hysteresis is in metres. The new
+    //gains are taken over when it finishes, the PID carrying on from the
+    //relay's last output. If it fails the old gains stay
+    void autotune (float32_t speed, float32_t hysteresis, RelayTune::Rule rule) {
+        relay.start(speed, hysteresis, 0, rule);
+    }
+
+    //Position gains from an auto-tune, e.g. one kept in flash, with the
+    //limits and filter of the present position PID. Resets the PID, so
+    //set them before the loops run
+    void tuned (TunedGains const& g) {
+        position.init(g.kp, g.ki, g.kd, position.alpha, position.lo, position.hi, position.rate);
+    }
+
+    //Replace the position PID by explicit MPC on a table from
+    //Host/mpcgen, built for the position loop rate. The setpoints then
+    //keep the rod within centre +/- the table stroke. 0 goes back to PID
+    void predictive (MpcTable const* table, float32_t centre) {
+        if (table) {
+            mpc.init(table, centre);
+            lastTarget = target.read();
+        } else {
+            mpc.table = 0;
+            position.reset(measuredPos.read());
+        }
+    }
+
+    //Schedule the position gains on an operating point, e.g. throttle or
+    //chamber pressure, which the application writes to operating (Q16 of
+    //full scale). The eased gains go to the position PID every tick, over
+    //auto-tuned ones. Load tables over the console with GainConsole on
+    //gains. 0 or an invalid table keeps the gains as they are
+    bool schedule (GainTable<SchedulePoints> const* table, float32_t blend) {
+        scheduled = false;
+        if (!table || !table->valid())
+            return false;
+        __asm volatile ("" ::: "memory");
+        gains.init(table, blend);
+        __asm volatile ("" ::: "memory");
+        scheduled = true;
+        return true;
+    }
+
+    //Start the loops afresh at position pos after a long stop, e.g. a
+    //flash erase, with set-up and gains kept: the PIDs, the velocity
+    //estimate, the tracker and the stall detector forget the old state
+    void restart (float32_t pos) {
+        position.reset(pos);
+        velocity.reset(0);
+        current.reset(0);
+        lastPos = pos;
+        vel = 0;
+        tracker.x[0] = pos;
+        tracker.x[1] = 0;
+        lastTarget = target.read();
+        measuredPos.write(pos);
+        measuredVel.write(0);
+        velocitySet.write(0);
+        currentSet.write(0);
+        stall.clear();
+        amps = duty = 0;
+    }
+
+    //Outer loop, lowest rate
+    void positionTick () {
+        float32_t sp = target.read(), pos = measuredPos.read();
+        if (scheduled) {
+            gains.update(operating.read());
+            position.retune(gains.kp, gains.ki, gains.kd);
+        }
+        if (!relay.running()) {
+            velocitySet.write(mpc.table ? predict(sp, pos) : position.update(sp, pos));
+            return;
+        }
+        float32_t u = relay.update(sp, pos);
+        velocitySet.write(u);
+        if (relay.state == RelayTune::DONE)
+            tuned(relay.result);
+        if (!relay.running())
+            position.reset(pos, u, sp - pos);
+    }
+
+    //MPC step, the target's velocity from its change since the last tick
+    float32_t predict (float32_t sp, float32_t pos) {
+        float32_t moving = (sp - lastTarget) / mpc.table->period;
+        lastTarget = sp;
+        return mpc.update(pos, measuredVel.read(), sp, moving);
+    }
+
+    //Middle loop, pos is a fresh position sample
+    void velocityTick (float32_t pos) {
+        if (kalman) {
+            pos = tracker.update(pos, currentSet.read());
+            vel = tracker.velocity();
+        } else
+            vel += alpha * ((pos - lastPos) * rate - vel);
+        lastPos = pos;
+        measuredPos.write(pos);
+        measuredVel.write(vel);
+        float32_t wanted = velocitySet.read(), set = velocity.update(wanted, vel);
+        currentSet.write(set);
+        if (watching)
+            stall.update(wanted, pos, set, amps, duty);
+    }
+
+    //Inner loop at PWM rate, returns the drive duty -1..1
+    float32_t currentTick (float32_t amps) {
+        this->amps = amps;
+        duty = current.update(currentSet.read(), amps);
+        return duty;
+    }
+
+    Pid<float32_t> position, velocity, current;
+    GainSchedule<SchedulePoints> gains;
+    RelayTune relay;
+    PositionTracker tracker;
+    ExplicitMpc mpc;
+    StallDetector<> stall;
+
+    Slot<float32_t> target;         //position setpoint, from the application
+    Slot<float32_t> velocitySet;    //from the position loop
+    Slot<float32_t> currentSet;     //from the velocity loop
+    Slot<float32_t> measuredPos;    //from the velocity loop
+    Slot<float32_t> measuredVel;
+    Slot<uint16_t> operating;       //gain scheduling variable, Q16
+
+    float32_t rate, alpha, lastPos, vel, lastTarget;
+    float32_t amps, duty;           //last of the current loop
+    bool kalman, watching, scheduled;
+};
+
+#endif //CONTROL_CASCADE
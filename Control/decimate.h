@@ -0,0 +1,113 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+#ifndef CONTROL_DECIMATE_
+#define CONTROL_DECIMATE_
+
+#include <stdint.h>
+#include <string.h>
+//Needs ARM_MATH_CM4 (target) or ARM_MATH_CM0 (portable C, host builds)
+#include "arm_math.h"
+
+//Oversampling and decimation of one ADC channel, a block at a time:
+//  boxcar - sums of R raw 12-bit samples (a first order CIC), R = 1, 2, 4,
+//           8 or 16, scaled to 16 bits by a shift. Noise on the input
+//           dithers the extra bits, up to 2 more with R = 16
+//  FIR    - T taps in Q15, worked out only for every d-th boxcar output,
+//           two taps per __SMLAD, the dual 16-bit multiply-accumulate of
+//           the M4, as arm_fir_decimate_fast_q15 does it
+//Out come 16-bit samples, 0..65535 for the ADC's full scale, at the raw
+//rate / (R * d). Taps summing to 32768 give unity gain, the sum of their
+//magnitudes has to stay below 65536 for the 32-bit accumulator
+//T - taps, even, R - boxcar length, B - most boxcar outputs worked on at
+//once, sizes the state
+template< int T, int R, int B >
+struct Decimator {
+    static_assert(T >= 2 && T % 2 == 0, "taps go in pairs");
+    static_assert(R == 1 || R == 2 || R == 4 || R == 8 || R == 16,
+                  "boxcar sums are scaled to 16 bits by a shift");
+    constexpr static int shift = R == 1 ? 4 : R == 2 ? 3 : R == 4 ? 2 : R == 8 ? 1 : 0;
+
+    //taps[0] weighs the newest sample, taps[T-1] the oldest
+    void init (int d, q15_t const* taps) {
+        factor = d;
+        for (int k = 0; k < T; ++k)
+            h[k] = taps[T - 1 - k]; //state runs oldest first, so do the taps
+        reset();
+    }
+
+    //Forget the history, the first T / d outputs settle from mid-scale
+    void reset () {
+        for (int k = 0; k < T - 1 + B; ++k)
+            x[k] = 0;
+        sum = summed = phase = 0;
+    }
+
+    //Consume n raw samples, in[0], in[stride], ..., e.g. one channel of
+    //interleaved scan frames. The outputs that came due go to out, at most
+    //n / (R * d) + 1 of them, their number is returned
+    int process (uint16_t const* in, int stride, int n, uint16_t* out) {
+        int outputs = 0;
+        while (n > 0) {
+            int m = 0;
+            for (; n > 0 && m < B; --n, in += stride) {
+                sum += *in;
+                if (++summed == R) {
+                    x[T - 1 + m++] = (q15_t) ((sum << shift) - 32768);
+                    sum = summed = 0;
+                }
+            }
+            for (int i = 0; i < m; ++i)
+                if (++phase == factor) {
+                    phase = 0;
+                    out[outputs++] = fir(x + i);
+                }
+            memmove(x, x + m, (T - 1) * sizeof (q15_t)); //keep the history
+        }
+        return outputs;
+    }
+
+    //T samples ending with the newest, against the reversed taps
+    uint16_t fir (q15_t const* p) const {
+        int32_t acc = 0;
+        for (int k = 0; k < T; k += 2)
+            acc = __SMLAD(pair(p + k), pair(h + k), acc);
+        int32_t y = ((acc + (1 << 14)) >> 15) + 32768;
+        return y < 0 ? 0 : y > 65535 ? 65535 : y;
+    }
+
+    //Two neighbouring q15 values as one word, an unaligned load on the M4
+    static int32_t pair (q15_t const* p) {
+        int32_t v;
+        memcpy(&v, p, sizeof v);
+        return v;
+    }
+
+    q15_t h [T];
+    q15_t x [T - 1 + B];        //T - 1 of history, then the new boxcar sums
+    int32_t sum;
+    int factor, summed, phase;
+};
+
+#endif //CONTROL_DECIMATE
@@ -0,0 +1,249 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef CONTROL_KALMAN_
+#define CONTROL_KALMAN_
+
+#include <stdint.h>
+
+//Linear Kalman filter, NX states, NZ measurements, NU inputs
+//Sizes are template arguments: matrices are plain arrays inside the
+//object, no heap, and every loop has a constant trip count the compiler
+//can unroll. The innovation covariance is inverted by hand-written 1x1,
+//2x2 and 3x3 kernels.
+//
+//Full mode runs the covariance update every tick. For a time-invariant
+//model the gain converges, steady() iterates the Riccati equation at
+//start-up and keeps the final gain, after which a tick is only
+//x = F x + B u + K (z - H x)
+
+template< int N >
+struct MatInverse;
+
+template<>
+struct MatInverse<1> {
+    static bool run (float const a [1][1], float b [1][1]) {
+        if (a[0][0] == 0)
+            return false;
+        b[0][0] = 1 / a[0][0];
+        return true;
+    }
+};
+
+template<>
+struct MatInverse<2> {
+    static bool run (float const a [2][2], float b [2][2]) {
+        float det = a[0][0] * a[1][1] - a[0][1] * a[1][0];
+        if (det == 0)
+            return false;
+        float r = 1 / det;
+        b[0][0] = a[1][1] * r;
+        b[0][1] = -a[0][1] * r;
+        b[1][0] = -a[1][0] * r;
+        b[1][1] = a[0][0] * r;
+        return true;
+    }
+};
+
+template<>
+struct MatInverse<3> {
+    static bool run (float const a [3][3], float b [3][3]) {
+        float c00 = a[1][1] * a[2][2] - a[1][2] * a[2][1];
+        float c01 = a[1][2] * a[2][0] - a[1][0] * a[2][2];
+        float c02 = a[1][0] * a[2][1] - a[1][1] * a[2][0];
+        float det = a[0][0] * c00 + a[0][1] * c01 + a[0][2] * c02;
+        if (det == 0)
+            return false;
+        float r = 1 / det;
+        b[0][0] = c00 * r;
+        b[1][0] = c01 * r;
+        b[2][0] = c02 * r;
+        b[0][1] = (a[0][2] * a[2][1] - a[0][1] * a[2][2]) * r;
+        b[1][1] = (a[0][0] * a[2][2] - a[0][2] * a[2][0]) * r;
+        b[2][1] = (a[0][1] * a[2][0] - a[0][0] * a[2][1]) * r;
+        b[0][2] = (a[0][1] * a[1][2] - a[0][2] * a[1][1]) * r;
+        b[1][2] = (a[0][2] * a[1][0] - a[0][0] * a[1][2]) * r;
+        b[2][2] = (a[0][0] * a[1][1] - a[0][1] * a[1][0]) * r;
+        return true;
+    }
+};
+
+template< int NX, int NZ, int NU =1 >
+struct Kalman {
+    static_assert(NZ >= 1 && NZ <= 3, "innovation inverse is written out for 1..3");
+
+    //Model: F, B, H, Q, R are set by the caller, P and x are the start
+    float F [NX][NX], B [NX][NU], H [NZ][NX];
+    float Q [NX][NX], R [NZ][NZ];
+    float P [NX][NX], K [NX][NZ];
+    float x [NX];
+    bool fixed = false;
+
+    //Project ahead one tick, u may be 0 for no input
+    void predict (float const* u =0) {
+        float n [NX];
+        for (int i = 0; i < NX; ++i) {
+            float s = 0;
+            for (int j = 0; j < NX; ++j)
+                s += F[i][j] * x[j];
+            if (u != 0)
+                for (int j = 0; j < NU; ++j)
+                    s += B[i][j] * u[j];
+            n[i] = s;
+        }
+        for (int i = 0; i < NX; ++i)
+            x[i] = n[i];
+        if (!fixed)
+            covariance();
+    }
+
+    //Fold in a measurement
+    void correct (float const* z) {
+        if (!fixed)
+            gain();
+        float e [NZ];
+        for (int i = 0; i < NZ; ++i) {
+            float s = z[i];
+            for (int j = 0; j < NX; ++j)
+                s -= H[i][j] * x[j];
+            e[i] = s;
+        }
+        for (int i = 0; i < NX; ++i)
+            for (int j = 0; j < NZ; ++j)
+                x[i] += K[i][j] * e[j];
+    }
+
+    void update (float const* z, float const* u =0) {
+        predict(u);
+        correct(z);
+    }
+
+    //Iterate the covariance until the gain settles, then keep that gain
+    void steady (int iterations =2000) {
+        fixed = false;
+        for (int n = 0; n < iterations; ++n) {
+            covariance();
+            gain();
+        }
+        fixed = true;
+    }
+
+    //P = F P F' + Q
+    void covariance () {
+        float t [NX][NX];
+        for (int i = 0; i < NX; ++i)
+            for (int j = 0; j < NX; ++j) {
+                float s = 0;
+                for (int k = 0; k < NX; ++k)
+                    s += F[i][k] * P[k][j];
+                t[i][j] = s;
+            }
+        for (int i = 0; i < NX; ++i)
+            for (int j = 0; j < NX; ++j) {
+                float s = Q[i][j];
+                for (int k = 0; k < NX; ++k)
+                    s += t[i][k] * F[j][k];
+                P[i][j] = s;
+            }
+    }
+
+    //K = P H' (H P H' + R)^-1, P = (I - K H) P
+    void gain () {
+        float ph [NX][NZ], s [NZ][NZ], si [NZ][NZ];
+        for (int i = 0; i < NX; ++i)
+            for (int j = 0; j < NZ; ++j) {
+                float v = 0;
+                for (int k = 0; k < NX; ++k)
+                    v += P[i][k] * H[j][k];
+                ph[i][j] = v;
+            }
+        for (int i = 0; i < NZ; ++i)
+            for (int j = 0; j < NZ; ++j) {
+                float v = R[i][j];
+                for (int k = 0; k < NX; ++k)
+                    v += H[i][k] * ph[k][j];
+                s[i][j] = v;
+            }
+        if (!MatInverse<NZ>::run(s, si))
+            return;
+        for (int i = 0; i < NX; ++i)
+            for (int j = 0; j < NZ; ++j) {
+                float v = 0;
+                for (int k = 0; k < NZ; ++k)
+                    v += ph[i][k] * si[k][j];
+                K[i][j] = v;
+            }
+
+        //P -= K (H P), with H P = ph'
+        float n [NX][NX];
+        for (int i = 0; i < NX; ++i)
+            for (int j = 0; j < NX; ++j) {
+                float v = P[i][j];
+                for (int k = 0; k < NZ; ++k)
+                    v -= K[i][k] * ph[j][k];
+                n[i][j] = v;
+            }
+        for (int i = 0; i < NX; ++i)
+            for (int j = 0; j < NX; ++j)
+                P[i][j] = n[i][j];
+    }
+};
+
+//Position and velocity from position samples at a fixed rate
+//Constant velocity model, plus a known input (e.g. drive current) giving
+//perInput units/s^2 of acceleration, accelNoise is the white acceleration
+//left unexplained (units/s^2) and posNoise the measurement noise (units)
+struct PositionTracker : Kalman<2,1> {
+    void init (float hz, float posNoise, float accelNoise,
+               float perInput =0, float position =0) {
+        float dt = 1 / hz, q = accelNoise * accelNoise;
+        F[0][0] = 1;
+        F[0][1] = dt;
+        F[1][0] = 0;
+        F[1][1] = 1;
+        B[0][0] = perInput * dt * dt / 2;
+        B[1][0] = perInput * dt;
+        H[0][0] = 1;
+        H[0][1] = 0;
+        Q[0][0] = q * dt * dt * dt * dt / 4;
+        Q[0][1] = Q[1][0] = q * dt * dt * dt / 2;
+        Q[1][1] = q * dt * dt;
+        R[0][0] = posNoise * posNoise;
+        P[0][0] = R[0][0];
+        P[0][1] = P[1][0] = 0;
+        P[1][1] = 0;
+        x[0] = position;
+        x[1] = 0;
+        steady();
+    }
+
+    float update (float position, float input =0) {
+        Kalman<2,1>::update(&position, &input);
+        return x[0];
+    }
+
+    float position () const { return x[0]; }
+    float velocity () const { return x[1]; }
+};
+
+#endif //CONTROL_KALMAN
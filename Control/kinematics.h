@@ -0,0 +1,228 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef CONTROL_KINEMATICS_
+#define CONTROL_KINEMATICS_
+
+#include <math.h>
+#include <stdint.h>
+
+//Dual linear-actuator gimbal kinematics
+//The bell pivots about the origin, z points aft along the thrust axis.
+//Pitch turns the bell about y, yaw about x (pitch outer, yaw inner).
+//Actuator a runs along x and actuator b along y: each is fixed to the bell
+//at distance r off the axis, h aft of the pivot, and to the frame at r+L0
+//
+//inverse(): angles -> actuator lengths, closed form (sinf/cosf/sqrtf)
+//lookup(): same, bilinear interpolation in a constexpr table in flash
+//forward(): lengths -> angles, chord-Newton iteration on either of them
+
+//Default geometry in metres and radians
+struct BellGimbal {
+    constexpr static double h = 0.060;      //bell mounts aft of the pivot
+    constexpr static double r = 0.030;      //bell mounts off the axis
+    constexpr static double length = 0.100; //actuator length at 0,0
+    constexpr static double limit = 0.14;   //+/- deflection, about 8 deg
+    constexpr static double stroke = 0.008; //+/- actuator travel from length
+};
+
+struct GimbalAngles {
+    float pitch, yaw;
+};
+
+struct ActuatorLengths {
+    float a, b;
+};
+
+//Math for tables, evaluated by the compiler
+struct ConstMath {
+    constexpr static double sin (double x) {
+        double term = x, sum = x;
+        for (int i = 1; i < 12; ++i) {
+            term *= -x * x / ((2*i) * (2*i + 1));
+            sum += term;
+        }
+        return sum;
+    }
+
+    constexpr static double cos (double x) {
+        double term = 1, sum = 1;
+        for (int i = 1; i < 12; ++i) {
+            term *= -x * x / ((2*i - 1) * (2*i));
+            sum += term;
+        }
+        return sum;
+    }
+
+    constexpr static double sqrt (double x) {
+        double y = x > 1 ? x : 1;
+        for (int i = 0; i < 60; ++i)
+            y = 0.5 * (y + x / y);
+        return y;
+    }
+};
+
+//Math at run time, single precision for the FPU
+struct FloatMath {
+    static float sin (float x) { return sinf(x); }
+    static float cos (float x) { return cosf(x); }
+    static float sqrt (float x) { return sqrtf(x); }
+};
+
+//Closed-form lengths, shared by the run-time path and the table builder
+template< typename G, typename M, typename T >
+constexpr ActuatorLengths gimbalLengths (T pitch, T yaw) {
+    T sp = M::sin(pitch), cp = M::cos(pitch);
+    T sy = M::sin(yaw), cy = M::cos(yaw);
+    T h = G::h, r = G::r, base = G::r + G::length;
+
+    //bell mount of actuator a, (r, 0, h) rotated
+    T ax = r * cp + h * cy * sp - base;
+    T ay = -h * sy;
+    T az = -r * sp + h * cy * cp - h;
+
+    //bell mount of actuator b, (0, r, h) rotated
+    T bz0 = r * sy + h * cy;
+    T bx = bz0 * sp;
+    T by = r * cy - h * sy - base;
+    T bz = bz0 * cp - h;
+
+    ActuatorLengths l {};
+    l.a = (float) M::sqrt(ax*ax + ay*ay + az*az);
+    l.b = (float) M::sqrt(bx*bx + by*by + bz*bz);
+    return l;
+}
+
+//Lengths on a (CELLS+1)^2 grid over +/- limit in both axes
+template< typename G, int CELLS >
+struct GimbalTable {
+    float len [CELLS+1][CELLS+1][2];
+
+    constexpr GimbalTable () : len () {
+        for (int i = 0; i <= CELLS; ++i)
+            for (int j = 0; j <= CELLS; ++j) {
+                double p = -G::limit + 2 * G::limit * i / CELLS;
+                double y = -G::limit + 2 * G::limit * j / CELLS;
+                ActuatorLengths l = gimbalLengths<G,ConstMath>(p, y);
+                len[i][j][0] = l.a;
+                len[i][j][1] = l.b;
+            }
+    }
+};
+
+//Length Jacobian at 0,0 and its inverse, in closed form. At rest both
+//actuators lie flat, along -x and -y, and rotating the bell swings each
+//mount by h along its actuator: da/dpitch = -h, db/dyaw = h, and the
+//cross terms have the mount moving at right angles to the actuator
+template< typename G >
+struct GimbalJacobian {
+    float fwd [2][2];   //d(a,b) / d(pitch,yaw)
+    float inv [2][2];
+
+    constexpr GimbalJacobian () : fwd (), inv () {
+        double ap = -G::h, ay = 0;
+        double bp = 0, by = G::h;
+        double det = ap * by - ay * bp;
+        fwd[0][0] = ap;
+        fwd[0][1] = ay;
+        fwd[1][0] = bp;
+        fwd[1][1] = by;
+        inv[0][0] = by / det;
+        inv[0][1] = -ay / det;
+        inv[1][0] = -bp / det;
+        inv[1][1] = ap / det;
+    }
+};
+
+template< typename G =BellGimbal, int CELLS =32 >
+struct Kinematics {
+    constexpr static float limit = G::limit;
+    constexpr static float step = 2 * G::limit / CELLS;
+    constexpr static float perStep = CELLS / (2 * G::limit);
+
+    static float clamp (float v) {
+        return v < -limit ? -limit : v > limit ? limit : v;
+    }
+
+    //Closed form, exact to float precision
+    static ActuatorLengths inverse (GimbalAngles g) {
+        return gimbalLengths<G,FloatMath>(clamp(g.pitch), clamp(g.yaw));
+    }
+
+    //Table lookup, bilinear between the four surrounding grid points
+    static ActuatorLengths lookup (GimbalAngles g) {
+        float u = (clamp(g.pitch) + limit) * perStep;
+        float v = (clamp(g.yaw) + limit) * perStep;
+        int i = (int) u, j = (int) v;
+        if (i > CELLS - 1)
+            i = CELLS - 1;
+        if (j > CELLS - 1)
+            j = CELLS - 1;
+        float fu = u - i, fv = v - j;
+
+        float const* p00 = table.len[i][j];
+        float const* p01 = table.len[i][j+1];
+        float const* p10 = table.len[i+1][j];
+        float const* p11 = table.len[i+1][j+1];
+        ActuatorLengths l;
+        float a0 = p00[0] + fv * (p01[0] - p00[0]);
+        float a1 = p10[0] + fv * (p11[0] - p10[0]);
+        float b0 = p00[1] + fv * (p01[1] - p00[1]);
+        float b1 = p10[1] + fv * (p11[1] - p10[1]);
+        l.a = a0 + fu * (a1 - a0);
+        l.b = b0 + fu * (b1 - b0);
+        return l;
+    }
+
+    //Angles for given lengths: g -= J0^-1 (L(g) - target), using the fixed
+    //Jacobian at 0,0. The lengths are nearly linear in the angles, each step
+    //cuts the error at least 5x even at full deflection. FAST uses lookup()
+    template< bool FAST =false >
+    static GimbalAngles forward (ActuatorLengths target, int steps =6) {
+        GimbalAngles g { 0, 0 };
+        for (int n = 0; n < steps; ++n) {
+            ActuatorLengths l = FAST ? lookup(g) : inverse(g);
+            float ea = l.a - target.a, eb = l.b - target.b;
+            g.pitch = clamp(g.pitch - (jacobian.inv[0][0] * ea + jacobian.inv[0][1] * eb));
+            g.yaw = clamp(g.yaw - (jacobian.inv[1][0] * ea + jacobian.inv[1][1] * eb));
+        }
+        return g;
+    }
+
+    constexpr static GimbalTable<G,CELLS> table {};
+    constexpr static GimbalJacobian<G> jacobian {};
+};
+
+template< typename G, int CELLS >
+constexpr float Kinematics<G,CELLS>::limit;
+
+template< typename G, int CELLS >
+constexpr float Kinematics<G,CELLS>::perStep;
+
+template< typename G, int CELLS >
+constexpr GimbalTable<G,CELLS> Kinematics<G,CELLS>::table;
+
+template< typename G, int CELLS >
+constexpr GimbalJacobian<G> Kinematics<G,CELLS>::jacobian;
+
+#endif //CONTROL_KINEMATICS
@@ -0,0 +1,114 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef CONTROL_MPC_
+#define CONTROL_MPC_
+
+#include <stdint.h>
+
+//Explicit model predictive control of one actuator
+//The MPC problem - track a target with the rod inside its stroke and
+//the velocity setpoint inside its limit - is solved offline for all
+//states by Host/mpcgen.h. The solution is piecewise affine: the state
+//space splits into polyhedral regions, each with an affine law. Per tick
+//the evaluator finds the region holding the state and applies its law,
+//so the constraints are met without any solver on the target.
+//
+//The state is theta = (position, velocity, target), positions relative
+//to the stroke centre in table units. The region found last tick is
+//tried first, the state rarely leaves it, then all regions in the order
+//the generator found them most used. A state outside every region (not
+//reachable within the constraints) gets the region it violates least
+
+//One table, the format written by Host/mpcgen and read here
+struct MpcTable {
+    float unit;             //table units per metre of position
+    float stroke, rate;     //the constraints it was built for: m, m/s
+    float period;           //tick it was built for, s
+    uint16_t regions;
+    uint16_t const* first;  //rows of region i are first[i] .. first[i+1]-1
+    float const (*rows)[4]; //a . theta <= b, stored a0 a1 a2 b
+    float const (*law)[4];  //velocity setpoint l . theta + l3, m/s
+};
+
+struct ExplicitMpc {
+    //centre - stroke centre in measurement units (m)
+    void init (MpcTable const* t, float centre) {
+        table = t;
+        this->centre = centre;
+        region = 0;
+        searched = 0;
+    }
+
+    //How far theta lies outside region r, <= 0 inside
+    float outside (int r, float const* theta, float limit) const {
+        float worst = -1e30f;
+        for (int i = table->first[r]; i < table->first[r+1]; ++i) {
+            float const* a = table->rows[i];
+            float v = a[0] * theta[0] + a[1] * theta[1] + a[2] * theta[2] - a[3];
+            if (v > worst) {
+                worst = v;
+                if (worst > limit)
+                    break;
+            }
+        }
+        return worst;
+    }
+
+    //Velocity setpoint for position and velocity (m, m/s) and a target
+    //(m) moving at targetVel (m/s). The table assumes a target at rest,
+    //a moving one is followed in its own frame: the law acts on the
+    //velocity relative to it and its velocity is added on top
+    float update (float position, float velocity, float target, float targetVel =0) {
+        float r = table->rate;
+        targetVel = targetVel < -r ? -r : targetVel > r ? r : targetVel;
+        float theta [3] = { (position - centre) * table->unit, velocity - targetVel,
+                            (target - centre) * table->unit };
+        searched = 1;
+        float best = outside(region, theta, 1e30f);
+        if (best > 0)
+            for (int r = 0; r < table->regions; ++r) {
+                if (r == region)
+                    continue;
+                ++searched;
+                float v = outside(r, theta, best);
+                if (v < best) {
+                    best = v;
+                    region = r;
+                    if (v <= 0)
+                        break;
+                }
+            }
+
+        float const* l = table->law[region];
+        float u = l[0] * theta[0] + l[1] * theta[1] + l[2] * theta[2] + l[3] + targetVel;
+        return u < -r ? -r : u > r ? r : u;
+    }
+
+    MpcTable const* table;
+    float centre;
+    int region;             //in use, for telemetry
+    int searched;           //regions tested in the last update
+};
+
+#endif //CONTROL_MPC
@@ -0,0 +1,160 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef CONTROL_PID_
+#define CONTROL_PID_
+
+//Needs ARM_MATH_CM4 (target) or ARM_MATH_CM0 (portable C, host builds)
+#include "arm_math.h"
+
+//Actuator position PID for T = float32_t, q31_t or q15_t
+//P and I run through the CMSIS arm_pid_* kernels, which keep the last
+//output as state. D works on the measurement, not the error, so setpoint
+//steps don't kick the output, and is low-pass filtered. After clamping
+//and rate limiting, the PI state is set back to what was really applied
+//(back-calculation), so the integrator can't wind up against a limit.
+//Without an integral gain there is nothing to wind up and the state is
+//left alone, else a clamp would freeze an offset into the P term
+//
+//All gains are per sample: ki includes the sample time, kd its inverse
+//Fixed point gains, limits and signals are fractions below 1.0, scale
+//the plant units to fit. Keep q31 limits within +/-0.5, arm_pid_q31 wraps
+
+template< typename T >
+struct PidMath;
+
+template<>
+struct PidMath<float32_t> {
+    typedef arm_pid_instance_f32 Instance;
+
+    static float32_t run (Instance* s, float32_t e) { return arm_pid_f32(s, e); }
+    static float32_t mul (float32_t a, float32_t b) { return a * b; }
+    static float32_t add (float32_t a, float32_t b) { return a + b; }
+    static float32_t sub (float32_t a, float32_t b) { return a - b; }
+
+    static void gains (Instance* s, float32_t kp, float32_t ki) {
+        s->A0 = kp + ki;
+        s->A1 = -kp;
+        s->A2 = 0;
+    }
+};
+
+template<>
+struct PidMath<q31_t> {
+    typedef arm_pid_instance_q31 Instance;
+
+    static q31_t run (Instance* s, q31_t e) { return arm_pid_q31(s, e); }
+    static q31_t mul (q31_t a, q31_t b) { return ((q63_t) a * b) >> 31; }
+    static q31_t add (q31_t a, q31_t b) { return clip_q63_to_q31((q63_t) a + b); }
+    static q31_t sub (q31_t a, q31_t b) { return clip_q63_to_q31((q63_t) a - b); }
+
+    static void gains (Instance* s, q31_t kp, q31_t ki) {
+        s->A0 = add(kp, ki);
+        s->A1 = -kp;
+        s->A2 = 0;
+    }
+};
+
+template<>
+struct PidMath<q15_t> {
+    typedef arm_pid_instance_q15 Instance;
+
+    static q15_t run (Instance* s, q15_t e) { return arm_pid_q15(s, e); }
+    static q15_t mul (q15_t a, q15_t b) { return ((q31_t) a * b) >> 15; }
+    static q15_t add (q15_t a, q15_t b) { return __SSAT((q31_t) a + b, 16); }
+    static q15_t sub (q15_t a, q15_t b) { return __SSAT((q31_t) a - b, 16); }
+
+    static void gains (Instance* s, q15_t kp, q15_t ki) {
+        s->A0 = add(kp, ki);
+#ifdef ARM_MATH_CM0_FAMILY
+        s->A1 = -kp;
+        s->A2 = 0;
+#else
+        s->A1 = (uint16_t) -kp; //A2 = kd = 0 in the top half, see arm_pid_q15
+#endif
+    }
+};
+
+template< typename T >
+struct Pid {
+    typedef PidMath<T> M;
+
+    //alpha - derivative filter, 1.0 (or max) = unfiltered, smaller = smoother
+    //lo, hi - output limits, rate - maximum output change per sample
+    void init (T kp, T ki, T kd, T alpha, T lo, T hi, T rate) {
+        M::gains(&pi, kp, ki);
+        this->kd = kd;
+        this->alpha = alpha;
+        this->lo = lo;
+        this->hi = hi;
+        this->rate = rate;
+        integral = ki != 0;
+        reset(0);
+    }
+
+    //Restart at output u with no history, e.g. when taking over bumplessly
+    //from another controller. Pass the present error too, the P term then
+    //moves the output from u by what the error changes, not by all of it
+    void reset (T measurement, T u =0, T error =0) {
+        pi.state[0] = error;
+        pi.state[1] = 0;
+        pi.state[2] = u;
+        last = measurement;
+        slope = 0;
+        out = u;
+    }
+
+    //New gains on the fly, e.g. from a gain schedule. The PI part works
+    //on the change in error, so the output carries on where it was, only
+    //the derivative term moves with kd
+    void retune (T kp, T ki, T kd) {
+        M::gains(&pi, kp, ki);
+        this->kd = kd;
+        integral = ki != 0;
+    }
+
+    T update (T setpoint, T measurement) {
+        //filtered derivative of -measurement
+        slope = M::add(slope, M::mul(alpha, M::sub(M::sub(last, measurement), slope)));
+        last = measurement;
+        T d = M::mul(kd, slope);
+
+        T u = M::add(M::run(&pi, M::sub(setpoint, measurement)), d);
+
+        T down = M::sub(out, rate), up = M::add(out, rate);
+        T min = down > lo ? down : lo, max = up < hi ? up : hi;
+        u = u < min ? min : u > max ? max : u;
+
+        if (integral)
+            pi.state[2] = M::sub(u, d);
+        out = u;
+        return u;
+    }
+
+    typename M::Instance pi;
+    T kd, alpha, lo, hi, rate;
+    T last, slope, out;
+    bool integral;
+};
+
+#endif //CONTROL_PID
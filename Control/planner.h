@@ -0,0 +1,99 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef CONTROL_PLANNER_
+#define CONTROL_PLANNER_
+
+#include <stdint.h>
+
+//Flow-to-pulse planner for an on/off valve, see cfg.txt
+//Inputs: entry flow rate, valve response time, desired output flow rate
+//Output: open signal + duration, then close signal + duration, per period
+//
+//The valve is pulse-width modulated with a fixed PERIOD (us). Open time is
+//PERIOD * desired / entry, the division is replaced by a reciprocal table
+//lookup with linear interpolation (about 16 bit accurate). Pulses shorter
+//than the valve response time can't be delivered, they are held back and
+//added to the next period instead, so the average flow is still met.
+//No division, no loops, no allocation: safe to call from an interrupt.
+
+//Reciprocals 2^31 / (256 + i), for entry flows normalised to 8.7 bits
+struct RecipTable {
+    uint32_t v [257];
+
+    constexpr RecipTable () : v () {
+        for (int i = 0; i <= 256; ++i)
+            v[i] = ((1ULL << 31) + (256 + i) / 2) / (256 + i);
+    }
+};
+
+//Open/close schedule for one period, in us
+struct Pulse {
+    uint32_t open;      //valve open for this long, from the start of the period
+    uint32_t close;     //then closed for the rest of the period
+};
+
+template< uint32_t PERIOD >
+struct FlowPlanner {
+    static_assert(PERIOD > 0 && PERIOD < 65536, "period must fit 16 bits");
+
+    //Open fraction desired/entry as Q16, 65536 = fully open
+    static uint32_t ratio (uint16_t entry, uint16_t desired) {
+        if (desired == 0)
+            return 0;
+        if (desired >= entry)
+            return 1 << 16;
+
+        //Normalise entry to [2^15, 2^16), 8 bit index + 7 bit fraction
+        int shift = __builtin_clz(entry) - 16;
+        uint32_t m = (uint32_t) entry << shift;
+        uint32_t i = (m >> 7) - 256, f = m & 0x7F;
+        uint32_t r = recip.v[i] - (((recip.v[i] - recip.v[i+1]) * f) >> 7);
+        return ((uint64_t) desired * r) >> (22 - shift);
+    }
+
+    //Schedule for the next period, response must be below PERIOD/2
+    Pulse plan (uint16_t entry, uint32_t response, uint16_t desired) {
+        int32_t want = (int32_t) ((ratio(entry, desired) * PERIOD) >> 16) + carry;
+        int32_t on = want < (int32_t) response ? 0 :
+                     want > (int32_t) (PERIOD - response) ? (int32_t) PERIOD : want;
+        carry = want - on;
+
+        Pulse p;
+        p.open = on;
+        p.close = PERIOD - on;
+        return p;
+    }
+
+    void reset () { carry = 0; }
+
+    //Open time (us) held back or delivered ahead, always below response
+    int32_t carry = 0;
+
+    constexpr static RecipTable recip {};
+};
+
+template< uint32_t PERIOD >
+constexpr RecipTable FlowPlanner<PERIOD>::recip;
+
+#endif //CONTROL_PLANNER
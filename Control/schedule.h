@@ -0,0 +1,128 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef CONTROL_SCHEDULE_
+#define CONTROL_SCHEDULE_
+
+#include <stdint.h>
+
+//Gain scheduling on throttle or chamber pressure
+//A table holds gains at a few operating points, in fixed point: the
+//scheduling variable and the gains are Q16 fractions of full scale, the
+//full-scale gains are per table. Tables can be constexpr, so they live in
+//flash and valid() can be checked by static_assert, or be loaded into RAM
+//at run time (see "Actuator Program"/gainconsole.h).
+//
+//Each tick the two breakpoints around the scheduling variable are found
+//by bisection, O(log N), and the gains interpolated between them. The
+//gains handed out ease towards the table by blend per tick, so neither a
+//new region nor a newly loaded table steps them. Pid::retune() takes them
+//without disturbing the loop state, Cascade::schedule() does so for the
+//position loop every tick
+
+//Gains at one operating point, all Q16
+struct GainPoint {
+    uint16_t at;            //scheduling variable, rising from point to point
+    uint16_t kp, ki, kd;    //fractions of the table's full-scale gains
+};
+
+template< int N >
+struct GainTable {
+    float kp, ki, kd;       //full-scale gains, per sample
+    uint8_t count;          //points in use
+    GainPoint point [N];
+
+    constexpr bool valid () const {
+        if (count < 1 || count > N)
+            return false;
+        for (int i = 1; i < count; ++i)
+            if (point[i].at <= point[i-1].at)
+                return false;
+        return true;
+    }
+};
+
+template< int N >
+struct GainSchedule {
+    typedef GainTable<N> Table;
+
+    //blend - fraction of the remaining difference applied per tick, 0..1
+    void init (Table const* t, float blend) {
+        table = t;
+        this->blend = blend;
+        kp = ki = kd = 0;
+        started = false;
+    }
+
+    //Switch tables, t has to stay put while in use
+    bool use (Table const* t) {
+        if (!t->valid())
+            return false;
+        __asm volatile ("" ::: "memory");
+        table = t;
+        return true;
+    }
+
+    //Table gains at x, Q16, into g[3]
+    static void lookup (Table const& t, uint16_t x, uint16_t* g) {
+        GainPoint const* p = t.point;
+        int lo = 0, hi = t.count - 1;
+        if (x <= p[lo].at || lo == hi)
+            hi = lo;
+        else if (x >= p[hi].at)
+            lo = hi;
+        else
+            while (hi - lo > 1) {
+                int mid = (lo + hi) / 2;
+                (p[mid].at <= x ? lo : hi) = mid;
+            }
+
+        //a full-scale step times f needs 33 bits, one SMULL on the M4
+        int64_t f = lo == hi ? 0 :
+                    ((uint32_t) (x - p[lo].at) << 16) / (p[hi].at - p[lo].at);
+        g[0] = p[lo].kp + (((p[hi].kp - p[lo].kp) * f) >> 16);
+        g[1] = p[lo].ki + (((p[hi].ki - p[lo].ki) * f) >> 16);
+        g[2] = p[lo].kd + (((p[hi].kd - p[lo].kd) * f) >> 16);
+    }
+
+    //Once per tick, x is the scheduling variable, Q16 of full scale
+    void update (uint16_t x) {
+        Table const* t = table;
+        uint16_t g [3];
+        lookup(*t, x, g);
+        constexpr float q = 1.0f / 65536;
+        float wkp = t->kp * q * g[0], wki = t->ki * q * g[1], wkd = t->kd * q * g[2];
+        float b = started ? blend : 1;
+        kp += b * (wkp - kp);
+        ki += b * (wki - ki);
+        kd += b * (wkd - kd);
+        started = true;
+    }
+
+    float kp, ki, kd;       //eased gains, per sample
+    Table const* volatile table;
+    float blend;
+    bool started;
+};
+
+#endif //CONTROL_SCHEDULE
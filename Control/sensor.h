@@ -0,0 +1,100 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+#ifndef CONTROL_SENSOR_
+#define CONTROL_SENSOR_
+
+#include <stdint.h>
+
+//Calibrated ADC channels in integer arithmetic. A reading becomes units
+//as (raw * k >> 16) + offset: a multiply-accumulate and a shift, no
+//division, no float and no branch. The divisions all happen in refresh(),
+//called now and then with a VREFINT reading from the background scan,
+//which caches the supply and rescales the channels that depend on it:
+//  absolute    - a voltage against ground, reads high when VDDA sags,
+//                so k follows VDDA
+//  ratiometric - a sensor fed from VDDA, whose reading doesn't change
+//                with it, k is fixed
+//Each channel is a straight line through two points given in 12-bit
+//counts at the calibration supply, the one VREFINT's factory value was
+//taken at (3.3 V on the STM32F4). Readings may have more bits, e.g. the
+//16 of a Decimator. Units are the caller's: mV, Pa, thousandths of a
+//degree, as long as a count is worth less than 32768 of them
+template< int N >
+struct SensorBank {
+    struct Channel {
+        int32_t k, offset;      //Q16 units per count now, units at 0 counts
+        int32_t gain;           //Q16 units per count at the calibration supply
+        bool absolute;
+    };
+
+    //calMv - calibration supply, vrefCal - VREFINT counts at it
+    void init (uint32_t calMv, uint16_t vrefCal) {
+        supplyCal = calMv;
+        vrefAtCal = vrefCal;
+        for (int i = 0; i < N; ++i)
+            line(i, 0, 0, 4095, 4095, false);
+        refresh(vrefCal);
+    }
+
+    //Channel i reads units0 at raw0 and units1 at raw1 (12-bit counts at
+    //the calibration supply), from readings of "bits" bits
+    void line (int i, int32_t raw0, int32_t units0, int32_t raw1, int32_t units1,
+                bool absolute, int bits =12) {
+        Channel& c = ch[i];
+        int64_t rise = (int64_t) (units1 - units0) << 16;
+        c.gain = rise / ((int64_t) (raw1 - raw0) << (bits - 12));
+        c.offset = units0 - (int32_t) (((int64_t) raw0 * rise / (raw1 - raw0)) >> 16);
+        c.absolute = absolute;
+        c.k = absolute ? (int64_t) c.gain * vrefAtCal / vref : c.gain;
+    }
+
+    //Chip temperature in thousandths of a degree, from the factory
+    //readings at 30 and 110 C, absolute like every internal channel
+    void chipTemperature (int i, uint16_t cal30, uint16_t cal110) {
+        line(i, cal30, 30000, cal110, 110000, true);
+    }
+
+    //New VREFINT reading: the supply in mV and the absolute channels'
+    //scale follow it. vrefRaw in 12-bit counts, above 0
+    void refresh (uint16_t vrefRaw) {
+        vref = vrefRaw;
+        supply = supplyCal * vrefAtCal / vrefRaw;
+        for (int i = 0; i < N; ++i)
+            if (ch[i].absolute)
+                ch[i].k = (int64_t) ch[i].gain * vrefAtCal / vrefRaw;
+    }
+
+    //Reading of channel i in its units
+    int32_t read (int i, uint32_t raw) const {
+        return (int32_t) ((int64_t) raw * ch[i].k >> 16) + ch[i].offset;
+    }
+
+    Channel ch [N];
+    uint32_t supply;            //VDDA in mV, as of the last refresh()
+    uint32_t supplyCal;
+    uint16_t vref, vrefAtCal;
+};
+
+#endif //CONTROL_SENSOR
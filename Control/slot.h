@@ -0,0 +1,59 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef CONTROL_SLOT_
+#define CONTROL_SLOT_
+
+#include <stdint.h>
+
+//Lock-free single-writer slot, hands values between interrupt levels
+//The writer fills the buffer that is not published, then bumps seq. A
+//reader interrupted by the writer sees seq change and copies again, a
+//reader interrupting the writer gets the previous value. Neither side
+//ever waits on the other, so this is safe in either priority order
+template< typename T >
+struct Slot {
+    void write (T const& v) {
+        uint32_t s = seq;
+        buf[(s + 1) & 1] = v;
+        __asm volatile ("" ::: "memory");
+        seq = s + 1;
+    }
+
+    T read () const {
+        T v;
+        uint32_t s;
+        do {
+            s = seq;
+            __asm volatile ("" ::: "memory");
+            v = buf[s & 1];
+            __asm volatile ("" ::: "memory");
+        } while (s != seq);
+        return v;
+    }
+
+    T buf [2] {};
+    uint32_t volatile seq = 0;
+};
+
+#endif //CONTROL_SLOT
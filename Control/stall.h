@@ -0,0 +1,119 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+#ifndef CONTROL_STALL_
+#define CONTROL_STALL_
+
+#include <stdint.h>
+
+//Stall and jam detection for one actuator, from what the loops sample
+//anyway: velocity and current setpoints, measured current, duty and
+//position. Sliding sums over the last W samples give, in O(1) each,
+//  wanted - travel the velocity setpoints asked for across the window
+//  moved  - travel the position made across the window
+//  effort - mean |current setpoint|, flow - mean |measured current|
+//  drive  - mean |duty|
+//The sums are integers (um, mA, 1/1000 duty) so they never drift.
+//Two faults are told apart:
+//  JAM  - the loop asks for travel and pushes current, the rod stays
+//  OPEN - the current loop drives hard and no current flows, an open
+//         winding, lead or bridge
+//A condition has to hold for latchMs before the fault latches, so it is
+//flagged within W samples plus latchMs of the event. It stays until clear()
+template< int W =64 >
+struct StallDetector {
+    enum Fault { NONE, JAM, OPEN };
+
+    //hz - sample rate, latchMs - time a condition has to persist
+    //effortAmps - mean current setpoint that counts as pushing
+    //travel - least wanted travel across the window to judge progress by, m
+    //openDuty - mean duty 0..1 at which a lack of current is a fault
+    void init (float hz, float latchMs, float effortAmps, float travel, float openDuty =0.8f) {
+        rate = hz;
+        latch = latchMs * hz / 1000;
+        effortMin = effortAmps * 1000 * W;
+        travelMin = travel * 1e6f;
+        driveMin = openDuty * 1000 * W;
+        clear();
+    }
+
+    //Forget the window and any fault
+    void clear () {
+        for (int i = 0; i < W; ++i)
+            want[i] = effort[i] = flow[i] = drive[i] = position[i] = 0;
+        sumWant = sumEffort = sumFlow = sumDrive = 0;
+        next = filled = jamFor = openFor = 0;
+        fault = NONE;
+    }
+
+    //One sample: velocity setpoint m/s, position m, current setpoint A,
+    //measured current A, duty -1..1. Returns true once a fault latched
+    bool update (float velocitySet, float pos, float ampsSet, float amps, float duty) {
+        int32_t w = velocitySet * 1e6f, e = magnitude(ampsSet * 1000),
+                f = magnitude(amps * 1000), d = magnitude(duty * 1000);
+        //position[next] is the oldest sample, about to be replaced
+        int32_t p = pos * 1e6f, moved = p - position[next];
+        sumWant += w - want[next];
+        sumEffort += e - effort[next];
+        sumFlow += f - flow[next];
+        sumDrive += d - drive[next];
+        want[next] = w;
+        effort[next] = e;
+        flow[next] = f;
+        drive[next] = d;
+        position[next] = p;
+        next = next + 1 < W ? next + 1 : 0;
+        if (fault != NONE)
+            return true;
+        if (filled < W) {
+            ++filled;
+            return false;
+        }
+
+        //wanted travel, um: sum of um/s over the sample rate
+        int32_t wanted = magnitude(sumWant / rate);
+        bool jam = sumEffort >= effortMin && 2 * sumFlow >= sumEffort &&
+                   wanted >= travelMin && 8 * magnitude(moved) < wanted;
+        bool open = sumDrive >= driveMin && 8 * sumFlow < effortMin;
+        jamFor = jam ? jamFor + 1 : 0;
+        openFor = open ? openFor + 1 : 0;
+        if (jamFor > latch)
+            fault = JAM;
+        else if (openFor > latch)
+            fault = OPEN;
+        return fault != NONE;
+    }
+
+    static int32_t magnitude (float v) { return v < 0 ? -v : v; }
+
+    int32_t want [W], effort [W], flow [W], drive [W], position [W];
+    int32_t sumWant, sumEffort, sumFlow, sumDrive;
+    int32_t effortMin, travelMin, driveMin;
+    int next, filled;
+    uint32_t latch, jamFor, openFor;
+    float rate;
+    Fault volatile fault;
+};
+
+#endif //CONTROL_STALL
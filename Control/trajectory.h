@@ -0,0 +1,155 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+#ifndef CONTROL_TRAJECTORY_
+#define CONTROL_TRAJECTORY_
+
+#include <math.h>
+#include <stdint.h>
+
+#include "kinematics.h"
+
+//Jerk-limited (S-curve) setpoint generator, streaming: the target may
+//change on any tick and the output follows it within the velocity,
+//acceleration and jerk limits. State is kept in units per tick, so a
+//tick is only adds, multiplies and one square root, the divisions are
+//all done in init().
+//
+//The velocity wanted at distance d from the target is the fastest one
+//that can still be braked to rest with an S-curve:
+//  v^2 / 2A + v Ta / 2 = d, Ta = A / J  =>  v = sqrt(c^2 + 2 A d) - c
+//with c = A Ta / 2. It's compared against the velocity the axis would
+//reach if its acceleration were ramped to zero now, v + a |a| / 2J, and
+//the difference sets the acceleration, which moves by at most J a tick.
+//Near the target this is linear, critically damped and settles without
+//overshoot.
+//
+//T = float, or int32_t for Q16.16 fixed point in units the caller
+//picks, e.g. 10 urad. Positions must stay within +/-32767 units there
+
+template< typename T >
+struct CurveMath;
+
+template<>
+struct CurveMath<float> {
+    static float from (double v) { return v; }
+    static double to (float v) { return v; }
+    static float mul (float a, float b) { return a * b; }
+    //sqrt(a + b d)
+    static float root (float a, float b, float d) { return sqrtf(a + b * d); }
+};
+
+template<>
+struct CurveMath<int32_t> {
+    static int32_t from (double v) { return (int32_t) lround(v * 65536); }
+    static double to (int32_t v) { return v / 65536.0; }
+    static int32_t mul (int32_t a, int32_t b) { return ((int64_t) a * b) >> 16; }
+
+    //sqrt(a + b d), the sum in Q32 so it can't overflow, then bit by bit
+    static int32_t root (int32_t a, int32_t b, int32_t d) {
+        uint64_t x = ((int64_t) a << 16) + (int64_t) b * d, r = 0, bit = 1ULL << 62;
+        while (bit > x)
+            bit >>= 2;
+        for (; bit != 0; bit >>= 2)
+            if (x >= r + bit) {
+                x -= r + bit;
+                r = (r >> 1) + bit;
+            } else
+                r >>= 1;
+        return r;
+    }
+};
+
+template< typename T >
+struct SCurve {
+    typedef CurveMath<T> M;
+
+    //Limits per second, for update() called at tickHz
+    void init (double velocity, double accel, double jerk, double tickHz) {
+        double v = velocity / tickHz, a = accel / (tickHz * tickHz);
+        double j = jerk / (tickHz * tickHz * tickHz), ta = a / j;
+        vmax = M::from(v);
+        amax = M::from(a);
+        jmax = M::from(j);
+        c = M::from(a * ta / 2);
+        c2 = M::from(a * ta / 2 * a * ta / 2);
+        twoA = M::from(2 * a);
+        invJ = M::from(1 / j);
+        halfInvJ = M::from(1 / (2 * j));
+        gain = M::from(8 / ta < 0.5 ? 8 / ta : 0.5);
+    }
+
+    //Start at rest at a position
+    void reset (T position) {
+        x = position;
+        v = a = 0;
+    }
+
+    //Next setpoint towards target
+    T update (T target) {
+        //where the axis would be once the acceleration is ramped to zero
+        T abs = a < 0 ? -a : a, t = M::mul(abs, invJ);
+        T ahead = v + M::mul(M::mul(a, abs), halfInvJ);
+        T e = target - x - M::mul(t, v + M::mul(a, M::mul(t, third)));
+
+        T vb = M::root(c2, twoA, e < 0 ? -e : e) - c;
+        if (vb > vmax)
+            vb = vmax;
+        T want = M::mul((e < 0 ? -vb : vb) - ahead, gain);
+        want = want < -amax ? -amax : want > amax ? amax : want;
+
+        T da = want - a;
+        a += da < -jmax ? -jmax : da > jmax ? jmax : da;
+        v += a;
+        x += v;
+        return x;
+    }
+
+    T x, v, a;
+    T vmax, amax, jmax, c, c2, twoA, invJ, halfInvJ, gain;
+    T const third = M::from(1.0 / 3);
+};
+
+//Both gimbal axes, angles in radians, ready for Kinematics
+struct GimbalTrajectory {
+    void init (float velocity, float accel, float jerk, float tickHz) {
+        pitch.init(velocity, accel, jerk, tickHz);
+        yaw.init(velocity, accel, jerk, tickHz);
+    }
+
+    void reset (GimbalAngles g) {
+        pitch.reset(g.pitch);
+        yaw.reset(g.yaw);
+    }
+
+    GimbalAngles update (GimbalAngles target) {
+        GimbalAngles g;
+        g.pitch = pitch.update(target.pitch);
+        g.yaw = yaw.update(target.yaw);
+        return g;
+    }
+
+    SCurve<float> pitch, yaw;
+};
+
+#endif //CONTROL_TRAJECTORY
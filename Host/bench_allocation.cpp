@@ -0,0 +1,153 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+//Allocation benchmark: commands over twice the deflection range, the
+//reach and direction error of allocated angles against clamping each
+//actuator on its own, and cycles per update by kind of saturation, on
+//the time stamp counter where there is one
+
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+
+#include "Control/allocation.h"
+
+typedef Kinematics<> Gimbal;
+typedef Allocator<> Alloc;
+
+constexpr double RATE = 0.15 / 1000;    //actuator speed, m per 1 kHz tick
+
+static uint64_t stamp () {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+//Worst length beyond the stroke, m
+static double beyond (GimbalAngles g) {
+    ActuatorLengths l = Gimbal::inverse(g);
+    double a = std::fabs(l.a - BellGimbal::length) - BellGimbal::stroke;
+    double b = std::fabs(l.b - BellGimbal::length) - BellGimbal::stroke;
+    return std::fmax(0, std::fmax(a, b));
+}
+
+//Angle between the directions of two commands, rad
+static double turned (GimbalAngles a, GimbalAngles b) {
+    double d = std::atan2(a.yaw, a.pitch) - std::atan2(b.yaw, b.pitch);
+    return std::fabs(std::remainder(d, 2 * M_PI));
+}
+
+//Each actuator clamped to its stroke, then back to angles
+static GimbalAngles clamped (GimbalAngles g) {
+    ActuatorLengths l = Gimbal::inverse(g);
+    float lo = BellGimbal::length - BellGimbal::stroke, hi = BellGimbal::length + BellGimbal::stroke;
+    l.a = l.a < lo ? lo : l.a > hi ? hi : l.a;
+    l.b = l.b < lo ? lo : l.b > hi ? hi : l.b;
+    return Gimbal::forward(l);
+}
+
+//Ticks per update for commands of one kind. Each command is timed a few
+//times and the fastest kept, which drops preemption by the OS, then the
+//min, mean and max over all commands
+static void timeIt (const char* kind, GimbalAngles const* cmd, int n, bool fromCentre) {
+    Alloc alloc;
+    alloc.init(RATE);
+    uint64_t lo = ~0ULL, hi = 0, sum = 0;
+    volatile float sink = 0;
+    for (int i = 0; i < n; ++i) {
+        uint64_t best = ~0ULL;
+        for (int rep = 0; rep < 20; ++rep) {
+            alloc.reset(fromCentre ? GimbalAngles { 0, 0 } : cmd[i]);
+            uint64_t t0 = stamp();
+            GimbalAngles g = alloc.update(cmd[i]);
+            uint64_t t = stamp() - t0;
+            sink = g.pitch;
+            best = t < best ? t : best;
+        }
+        lo = best < lo ? best : lo;
+        hi = best > hi ? best : hi;
+        sum += best;
+    }
+    (void) sink;
+    printf("%-14s min %4llu mean %6.1f max %4llu ticks/update\n", kind,
+            (unsigned long long) lo, (double) sum / n, (unsigned long long) hi);
+}
+
+int main () {
+    constexpr int N = 200;
+    static GimbalAngles inside [N * N], outside [N * N];
+    int nIn = 0, nOut = 0;
+
+    //Commands on a grid over twice the deflection range
+    double worstAlloc = 0, worstClamp = 0, turnAlloc = 0, turnClamp = 0, unused = 0;
+    for (int i = 0; i < N; ++i)
+        for (int j = 0; j < N; ++j) {
+            GimbalAngles c { (float) (-0.28 + 0.56 * (i + 0.5) / N),
+                             (float) (-0.28 + 0.56 * (j + 0.5) / N) };
+            Alloc alloc;
+            alloc.init(1);  //speed out of the way
+            GimbalAngles a = alloc.update(c);
+            if (!(alloc.limited & Alloc::STROKE)) {
+                inside[nIn++] = c;
+                continue;
+            }
+            outside[nOut++] = c;
+            GimbalAngles k = clamped(c);
+            worstAlloc = std::fmax(worstAlloc, beyond(a));
+            worstClamp = std::fmax(worstClamp, beyond(k));
+            turnAlloc = std::fmax(turnAlloc, turned(a, c));
+            turnClamp = std::fmax(turnClamp, turned(k, c));
+
+            //how much further the exact boundary is in that direction
+            double lo = 1, hi = 2;
+            for (int n = 0; n < 30; ++n) {
+                double mid = (lo + hi) / 2;
+                GimbalAngles m { (float) (a.pitch * mid), (float) (a.yaw * mid) };
+                (beyond(m) > 0 || std::fabs(m.pitch) > Gimbal::limit ||
+                    std::fabs(m.yaw) > Gimbal::limit ? hi : lo) = mid;
+            }
+            unused = std::fmax(unused, (lo - 1) * std::hypot(a.pitch, a.yaw));
+        }
+    double rMin = 1, rMax = 0;
+    for (int k = 0; k < Alloc::polygon.count; ++k) {
+        rMin = std::fmin(rMin, Alloc::polygon.radius[k]);
+        rMax = std::fmax(rMax, Alloc::polygon.radius[k]);
+    }
+    printf("reach: %d of %d commands saturate, %d edges, radius %.3f..%.3f rad\n",
+            nOut, N * N, Alloc::polygon.count, rMin, rMax);
+    printf("allocated: beyond stroke %.2f um, direction off by %.2f mrad, "
+           "up to %.2f mrad short of the boundary\n",
+            1e6 * worstAlloc, 1e3 * turnAlloc, 1e3 * unused);
+    printf("clamped:   beyond stroke %.2f um, direction off by %.2f mrad\n",
+            1e6 * worstClamp, 1e3 * turnClamp);
+
+    //Timing, no limit / speed only / stroke only / both
+    timeIt("free", inside, nIn, false);
+    timeIt("speed", inside, nIn, true);
+    timeIt("stroke", outside, nOut, false);
+    timeIt("stroke+speed", outside, nOut, true);
+    return 0;
+}
@@ -0,0 +1,149 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+//Decimation benchmark: a slow, noisy 12-bit channel at the raw scan rate
+//of the ECU's slow inputs, oversampled by 16 and decimated by 4 to 16-bit
+//samples. Error against the true signal of the raw samples, the boxcar
+//alone and the whole pipeline, the gain at a few frequencies, and time
+//per raw sample, worked on in scan-sized blocks of interleaved frames
+
+#include <chrono>
+#include <cmath>
+#include <initializer_list>
+#include <stdio.h>
+
+#include "Control/decimate.h"
+
+constexpr double RATE = 21340;      //raw frames per second, 2 x 480-cycle conversions at 21 MHz
+constexpr int FRAMES = 64;          //per block, half the DMA ring
+constexpr int BOXCAR = 16, FACTOR = 4, TAPS = 16;
+constexpr int BLOCKS = 2000;
+constexpr double NOISE = 1.5;       //counts rms, sensor and ADC
+
+//Hamming-windowed sinc, cut off at 0.1 of the boxcar rate, as in valve.c
+static const q15_t taps [TAPS] = { -114, -159, -139, 291, 1450, 3284, 5246, 6525,
+                                   6525, 5246, 3284, 1450, 291, -139, -159, -114 };
+
+typedef Decimator<TAPS, BOXCAR, FRAMES / BOXCAR> Filter;
+
+//Gaussian-ish noise, repeatable
+static double noise () {
+    static uint32_t s = 1;
+    double sum = 0;
+    for (int i = 0; i < 4; ++i) {
+        s ^= s << 13;
+        s ^= s >> 17;
+        s ^= s << 5;
+        sum += s / 4294967296.0 - 0.5;
+    }
+    return sum * std::sqrt(3.0);
+}
+
+//Two channels of interleaved frames, like a scan of the ADC: channel 0
+//follows f(t) in counts, channel 1 sits at mid-scale
+static uint16_t frames [BLOCKS * FRAMES][2];
+
+template< typename F >
+static void fill (F f) {
+    for (int n = 0; n < BLOCKS * FRAMES; ++n) {
+        double v = f(n / RATE) + NOISE * noise();
+        frames[n][0] = v < 0 ? 0 : v > 4095 ? 4095 : (uint16_t) lround(v);
+        frames[n][1] = 2048;
+    }
+}
+
+//All outputs of channel 0 for the current frames, a block at a time
+static int run (Filter& filter, uint16_t* out) {
+    int count = 0;
+    for (int b = 0; b < BLOCKS; ++b)
+        count += filter.process(&frames[b * FRAMES][0], 2, FRAMES, out + count);
+    return count;
+}
+
+static double signal (double t) { return 2048 + 1500 * sin(2 * M_PI * 0.7 * t); }
+
+static uint16_t out [BLOCKS * FRAMES];
+
+//rms error in 16-bit steps, outputs compared with the input "delay" raw
+//samples before the last one they saw
+static double error (int step, int count, double delay, int skip) {
+    double e2 = 0;
+    for (int i = skip; i < count; ++i) {
+        double t = ((i + 1) * step - 1 - delay) / RATE;
+        double e = out[i] - 16 * signal(t);
+        e2 += e * e;
+    }
+    return std::sqrt(e2 / (count - skip));
+}
+
+static void bits (const char* name, double rms) {
+    printf("%-9s rms error %6.1f steps of 16 bits, %4.1f effective bits\n",
+            name, rms, 16 - std::log2(rms * std::sqrt(12.0)));
+}
+
+int main () {
+    fill(signal);
+    double e2 = 0;
+    for (int n = 0; n < BLOCKS * FRAMES; ++n) {
+        double e = 16 * (frames[n][0] - signal(n / RATE));
+        e2 += e * e;
+    }
+    bits("raw", std::sqrt(e2 / (BLOCKS * FRAMES)));
+
+    Filter filter;
+    const q15_t pass [2] = { 16384, 16384 };
+    filter.init(1, pass);
+    int count = run(filter, out);
+    bits("boxcar", error(BOXCAR, count, (BOXCAR - 1) / 2.0 + BOXCAR / 2.0, 4));
+
+    filter.init(FACTOR, taps);
+    count = run(filter, out);
+    double delay = (BOXCAR - 1) / 2.0 + BOXCAR * (TAPS - 1) / 2.0;
+    bits("decimated", error(BOXCAR * FACTOR, count, delay, TAPS));
+    printf("          %d outputs at %.0f Hz, delay %.2f ms\n",
+            count, RATE / (BOXCAR * FACTOR), 1e3 * delay / RATE);
+
+    //gain of a full-scale sine, in the settled second half
+    for (double hz : { 5.0, 50.0, 100.0, 200.0, 350.0 }) {
+        fill([hz](double t) { return 2048 + 1800 * sin(2 * M_PI * hz * t); });
+        filter.init(FACTOR, taps);
+        count = run(filter, out);
+        double p = 0;
+        for (int i = count / 2; i < count; ++i)
+            p += (out[i] - 32768.0) * (out[i] - 32768.0);
+        double amp = std::sqrt(2 * p / (count - count / 2)) / (16 * 1800);
+        printf("%5.0f Hz: gain %6.1f dB\n", hz, 20 * std::log10(amp));
+    }
+
+    int reps = 200;
+    volatile int sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; ++r)
+        sink = run(filter, out);
+    auto t1 = std::chrono::steady_clock::now();
+    (void) sink;
+    printf("%.2f ns per raw sample\n",
+            std::chrono::duration<double, std::nano>(t1 - t0).count() / reps / (BLOCKS * FRAMES));
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+//Kalman benchmark: position and velocity of a noisy swept position
+//signal, full covariance updates against the steady-state gain and
+//against smoothed differences, and time per update of each
+
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+
+#include "Control/kalman.h"
+
+constexpr int RATE = 2000;          //samples per second
+constexpr int STEPS = 4 * RATE;
+constexpr double NOISE = 7e-6;      //position noise, m rms
+constexpr double ACCEL = 2;         //unmodelled acceleration, m/s^2
+
+//Rod sweep, a few mm at a few Hz
+static double position (double t) { return 0.004 * sin(2 * M_PI * 1.3 * t) + 0.001 * sin(2 * M_PI * 7 * t); }
+static double velocity (double t) {
+    return 0.004 * 2 * M_PI * 1.3 * cos(2 * M_PI * 1.3 * t) + 0.001 * 2 * M_PI * 7 * cos(2 * M_PI * 7 * t);
+}
+
+//Gaussian-ish noise, repeatable
+static double noise () {
+    static uint32_t s = 1;
+    double sum = 0;
+    for (int i = 0; i < 4; ++i) {
+        s ^= s << 13;
+        s ^= s >> 17;
+        s ^= s << 5;
+        sum += s / 4294967296.0 - 0.5;
+    }
+    return sum * std::sqrt(3.0);
+}
+
+static double sample [STEPS];
+
+template< typename F >
+static void report (const char* name, F estimate) {
+    double ep = 0, ev = 0;
+    for (int n = 0; n < STEPS; ++n) {
+        double p, v, t = (double) n / RATE;
+        estimate(sample[n], p, v);
+        if (n < RATE / 4)
+            continue;
+        ep += (p - position(t)) * (p - position(t));
+        ev += (v - velocity(t)) * (v - velocity(t));
+    }
+    int calls = 0;
+    volatile double sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int rep = 0; rep < 500; ++rep)
+        for (int n = 0; n < STEPS; ++n, ++calls) {
+            double p, v;
+            estimate(sample[n], p, v);
+            sink = v;
+        }
+    auto t1 = std::chrono::steady_clock::now();
+    (void) sink;
+    int n = STEPS - RATE / 4;
+    printf("%-8s position rms %5.2f um, velocity rms %5.2f mm/s, %6.2f ns/update\n", name,
+            1e6 * std::sqrt(ep / n), 1e3 * std::sqrt(ev / n),
+            std::chrono::duration<double, std::nano>(t1 - t0).count() / calls);
+}
+
+int main () {
+    for (int n = 0; n < STEPS; ++n)
+        sample[n] = position((double) n / RATE) + NOISE * noise();
+
+    PositionTracker full, steady;
+    steady.init(RATE, NOISE, ACCEL);
+    full.init(RATE, NOISE, ACCEL);
+    full.fixed = false;
+    printf("steady-state gain: %.4f, %.2f /s\n", steady.K[0][0], steady.K[1][0]);
+
+    report("smoothed", [](double z, double& p, double& v) {
+        static double last = 0, vel = 0;
+        vel += 0.2 * ((z - last) * RATE - vel);
+        last = p = z;
+        v = vel;
+    });
+    report("full", [&](double z, double& p, double& v) {
+        p = full.update(z);
+        v = full.velocity();
+    });
+    report("steady", [&](double z, double& p, double& v) {
+        p = steady.update(z);
+        v = steady.velocity();
+    });
+    return 0;
+}
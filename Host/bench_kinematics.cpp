@@ -0,0 +1,126 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+//Kinematics benchmark: table against closed form over the whole range,
+//forward/inverse round trips, the Jacobian against central differences
+//of the closed form in double precision, and time per call of each path,
+//in ns and in cycles of the time stamp counter where there is one
+
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+
+#include "Control/kinematics.h"
+
+typedef Kinematics<> Gimbal;
+
+static uint64_t stamp () {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+template< typename F >
+static void timeIt (const char* name, F f, int calls) {
+    auto t0 = std::chrono::steady_clock::now();
+    uint64_t c0 = stamp();
+    f();
+    uint64_t c1 = stamp();
+    auto t1 = std::chrono::steady_clock::now();
+    printf("%s %.2f ns/call, %.1f cycles/call\n", name,
+            std::chrono::duration<double, std::nano>(t1 - t0).count() / calls,
+            (double) (c1 - c0) / calls);
+}
+
+//Lengths without the rounding to float, for the Jacobian check
+static void lengths (double p, double y, double l [2]) {
+    double h = BellGimbal::h, r = BellGimbal::r, base = BellGimbal::r + BellGimbal::length;
+    double ax = r * cos(p) + h * cos(y) * sin(p) - base, ay = -h * sin(y);
+    double az = -r * sin(p) + h * cos(y) * cos(p) - h;
+    double bz0 = r * sin(y) + h * cos(y);
+    double bx = bz0 * sin(p), by = r * cos(y) - h * sin(y) - base, bz = bz0 * cos(p) - h;
+    l[0] = sqrt(ax*ax + ay*ay + az*az);
+    l[1] = sqrt(bx*bx + by*by + bz*bz);
+}
+
+int main () {
+    constexpr int N = 400;
+    const float lim = Gimbal::limit;
+
+    //Accuracy of the table and of the forward solutions
+    double lookupErr = 0, fwdErr = 0, fastErr = 0;
+    for (int i = 0; i <= N; ++i)
+        for (int j = 0; j <= N; ++j) {
+            GimbalAngles g { -lim + 2 * lim * i / N, -lim + 2 * lim * j / N };
+            ActuatorLengths exact = Gimbal::inverse(g);
+            ActuatorLengths fast = Gimbal::lookup(g);
+            lookupErr = std::fmax(lookupErr, std::fabs(fast.a - exact.a));
+            lookupErr = std::fmax(lookupErr, std::fabs(fast.b - exact.b));
+
+            GimbalAngles f = Gimbal::forward(exact);
+            fwdErr = std::fmax(fwdErr, std::fabs(f.pitch - g.pitch));
+            fwdErr = std::fmax(fwdErr, std::fabs(f.yaw - g.yaw));
+            GimbalAngles ff = Gimbal::forward<true>(exact);
+            fastErr = std::fmax(fastErr, std::fabs(ff.pitch - g.pitch));
+            fastErr = std::fmax(fastErr, std::fabs(ff.yaw - g.yaw));
+        }
+    printf("lookup:  max error %.3f um against closed form\n", lookupErr * 1e6);
+    printf("forward: max error %.2e rad (closed form), %.2e rad (table)\n", fwdErr, fastErr);
+
+    //Jacobian at 0,0, columns pitch and yaw
+    constexpr double d = 1e-6;
+    double l0 [2], l1 [2], jacErr = 0;
+    for (int k = 0; k < 2; ++k) {
+        lengths(k ? 0 : -d, k ? -d : 0, l0);
+        lengths(k ? 0 : d, k ? d : 0, l1);
+        for (int row = 0; row < 2; ++row)
+            jacErr = std::fmax(jacErr, std::fabs((l1[row] - l0[row]) / (2*d) - Gimbal::jacobian.fwd[row][k]));
+    }
+    printf("jacobian: a/pitch %.6f, b/yaw %.6f, max error %.1e against differences\n",
+            Gimbal::jacobian.fwd[0][0], Gimbal::jacobian.fwd[1][1], jacErr);
+
+    //Speed, over the same grid
+    constexpr int calls = (N+1) * (N+1);
+    volatile float sink = 0;
+    auto sweep = [&](ActuatorLengths (*ik)(GimbalAngles)) {
+        float s = 0;
+        for (int i = 0; i <= N; ++i)
+            for (int j = 0; j <= N; ++j) {
+                ActuatorLengths l = ik({ -lim + 2 * lim * i / N, -lim + 2 * lim * j / N });
+                s += l.a + l.b;
+            }
+        sink = sink + s;
+    };
+    timeIt("inverse:", [&]{ sweep(Gimbal::inverse); }, calls);
+    timeIt("lookup: ", [&]{ sweep(Gimbal::lookup); }, calls);
+    timeIt("forward:", [&]{
+        for (int i = 0; i < calls; ++i) {
+            GimbalAngles g = Gimbal::forward({ 0.1f + i * 1e-8f, 0.1f });
+            sink = sink + g.pitch;
+        }
+    }, calls);
+    printf("table:   %u bytes of flash\n", (unsigned) sizeof Gimbal::table);
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+
+//Explicit MPC benchmark: tables for a few horizons, their size, how
+//closely the region search reproduces the QP solution, whether the rod
+//stays in its stroke chasing targets beyond it, and ticks per update
+//following a trajectory (the last region is usually right) against
+//states drawn at random (a full search)
+
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mpcgen.h"
+
+static uint64_t stamp () {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+static double uniform () { return rand() / (double) RAND_MAX * 2 - 1; }
+
+//Ticks per update, fastest of a few runs per state, then mean and max
+static void timeIt (const char* kind, ExplicitMpc& mpc, float const (*state)[3],
+                    int const* region, int n) {
+    uint64_t hi = 0, sum = 0;
+    int searched = 0;
+    volatile float sink = 0;
+    for (int i = 0; i < n; ++i) {
+        uint64_t best = ~0ULL;
+        for (int rep = 0; rep < 10; ++rep) {
+            mpc.region = region[i];
+            uint64_t t0 = stamp();
+            sink = mpc.update(state[i][0], state[i][1], state[i][2]);
+            uint64_t t = stamp() - t0;
+            best = t < best ? t : best;
+        }
+        searched += mpc.searched;
+        hi = best > hi ? best : hi;
+        sum += best;
+    }
+    (void) sink;
+    printf("  %-6s mean %6.1f max %5llu ticks/update, %.1f regions searched\n", kind,
+            (double) sum / n, (unsigned long long) hi, (double) searched / n);
+}
+
+int main () {
+    constexpr int N = 4000;
+    static float state [N][3];
+    static int warm [N], cold [N];
+
+    for (int horizon = 2; horizon <= 5; ++horizon) {
+        MpcParams p;
+        p.horizon = horizon;
+        p.grid = 16;
+        MpcBuild b;
+        auto t0 = std::chrono::steady_clock::now();
+        b.build(p);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        MpcTable table = b.table();
+        ExplicitMpc mpc;
+        mpc.init(&table, 0);
+        size_t bytes = b.first.size() * 2 + (b.rows.size() + b.law.size()) * 4;
+        printf("horizon %d: %zu regions, %zu rows, %zu bytes, built in %.1f s\n",
+                horizon, b.hits.size(), b.rows.size() / 4, bytes, secs);
+
+        //against the QP at random feasible states
+        double s = p.stroke * 1e3, worst = 0;
+        int tested = 0;
+        srand(1);
+        std::vector<double> l;
+        for (int i = 0; i < 2000; ++i) {
+            double theta [3] = { s * uniform(), p.rate * uniform(), p.reach * s * uniform() };
+            l.clear();
+            int64_t active = b.solve(theta, l);
+            double law [4];
+            std::vector<double> ineq;
+            if (active < 0 || !b.region(active, law, ineq))
+                continue;
+            double u = law[0] * theta[0] + law[1] * theta[1] + law[2] * theta[2] + law[3];
+            float e = mpc.update(theta[0] / 1e3, theta[1], theta[2] / 1e3);
+            worst = std::fmax(worst, std::fabs(e - u));
+            ++tested;
+        }
+
+        //closed loop on the model, targets out to twice the stroke
+        double a = exp(-p.period / p.lag), pos = 0, vel = 0, over = 0;
+        for (int i = 0; i < N; ++i) {
+            float target = (float) (2 * p.stroke * ((i / 250) % 2 ? -1 : 1) * ((i / 500) % 4 + 1) / 4);
+            state[i][0] = pos;
+            state[i][1] = vel;
+            state[i][2] = target;
+            warm[i] = mpc.region;
+            double u = mpc.update(pos, vel, target);
+            //exact over the tick for a held setpoint
+            pos += u * p.period + (vel - u) * p.lag * (1 - a);
+            vel = u + (vel - u) * a;
+            over = std::fmax(over, std::fabs(pos) - p.stroke);
+        }
+        printf("  setpoint within %.2e m/s of the QP over %d states, "
+               "%.2f um beyond the stroke in closed loop\n", worst, tested, 1e6 * std::fmax(over, 0));
+
+        timeIt("warm", mpc, state, warm, N);
+        for (int i = 0; i < N; ++i) {
+            state[i][0] = p.stroke * uniform();
+            state[i][1] = p.rate * uniform();
+            state[i][2] = p.reach * p.stroke * uniform();
+            cold[i] = rand() % table.regions;
+        }
+        timeIt("cold", mpc, state, cold, N);
+    }
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+//PID benchmark: float, q31 and q15 controllers closing the same loop
+//around an actuator model, tracking error against the float controller
+//and time per update
+
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+
+#include "Control/pid.h"
+
+constexpr int RATE = 4000;      //control rate, Hz
+constexpr int STEPS = 4 * RATE; //4 s of setpoint steps and ramps
+
+//Gains and limits as fractions of full scale
+constexpr double KP = 0.6, KI = 0.004, KD = 0.5, ALPHA = 0.25;
+constexpr double LIMIT = 0.45, RATE_LIMIT = 0.01;
+
+//Actuator: first-order velocity lag, integrated to position
+struct Plant {
+    double x = 0, v = 0;
+
+    double step (double u) {
+        constexpr double dt = 1.0 / RATE, tau = 0.02, gain = 8;
+        v += dt / tau * (gain * u - v);
+        x += v * dt;
+        return x;
+    }
+};
+
+static double setpoint (int n) {
+    double t = (double) n / RATE;
+    return t < 1 ? 0.2 : t < 2 ? -0.2 : t < 3 ? -0.2 + 0.3 * (t - 2) : 0.05;
+}
+
+template< typename T > T fromDouble (double v);
+template<> float32_t fromDouble (double v) { return v; }
+template<> q31_t fromDouble (double v) { return std::lround(v * 2147483648.0); }
+template<> q15_t fromDouble (double v) { return std::lround(v * 32768.0); }
+
+static double toDouble (float32_t v) { return v; }
+static double toDouble (q31_t v) { return v / 2147483648.0; }
+static double toDouble (q15_t v) { return v / 32768.0; }
+
+//Closed loop run, records the plant position trace
+template< typename T >
+static void run (double* trace) {
+    Pid<T> pid;
+    pid.init(fromDouble<T>(KP), fromDouble<T>(KI), fromDouble<T>(KD),
+             fromDouble<T>(ALPHA), fromDouble<T>(-LIMIT), fromDouble<T>(LIMIT),
+             fromDouble<T>(RATE_LIMIT));
+    Plant plant;
+    double x = 0;
+    for (int n = 0; n < STEPS; ++n) {
+        T u = pid.update(fromDouble<T>(setpoint(n)), fromDouble<T>(x));
+        x = plant.step(toDouble(u));
+        trace[n] = x;
+    }
+}
+
+//Time per update, open loop on a fixed input sweep
+template< typename T >
+static double timeIt () {
+    constexpr int calls = 10000000;
+    Pid<T> pid;
+    pid.init(fromDouble<T>(KP), fromDouble<T>(KI), fromDouble<T>(KD),
+             fromDouble<T>(ALPHA), fromDouble<T>(-LIMIT), fromDouble<T>(LIMIT),
+             fromDouble<T>(RATE_LIMIT));
+    T in [64];
+    for (int i = 0; i < 64; ++i)
+        in[i] = fromDouble<T>(0.3 * std::sin(i * 0.1));
+    volatile T sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; ++i)
+        sink = pid.update(in[i & 63], in[(i + 7) & 63]);
+    auto t1 = std::chrono::steady_clock::now();
+    (void) sink;
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / calls;
+}
+
+static double ref [STEPS], trace [STEPS];
+
+template< typename T >
+static void report (const char* name) {
+    run<T>(trace);
+    double sum = 0, worst = 0, track = 0;
+    for (int n = 0; n < STEPS; ++n) {
+        double d = trace[n] - ref[n];
+        sum += d * d;
+        worst = std::fmax(worst, std::fabs(d));
+        track += (trace[n] - setpoint(n)) * (trace[n] - setpoint(n));
+    }
+    printf("%-6s rms tracking %.5f, vs float rms %.2e max %.2e, %.2f ns/update\n",
+            name, std::sqrt(track / STEPS), std::sqrt(sum / STEPS), worst, timeIt<T>());
+}
+
+int main () {
+    run<float32_t>(ref);
+    report<float32_t>("float");
+    report<q31_t>("q31");
+    report<q15_t>("q15");
+    return 0;
+}
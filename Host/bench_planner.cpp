@@ -0,0 +1,66 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+//Flow planner benchmark: ratio accuracy against exact division over every
+//entry flow, and time per plan() call over the full input range
+
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+
+#include "Control/planner.h"
+
+typedef FlowPlanner<20000> Planner;     //50 Hz valve PWM
+
+int main () {
+    //Accuracy, every entry flow against a spread of desired flows
+    double worst = 0;
+    uint32_t worstEntry = 0, worstDesired = 0;
+    for (uint32_t entry = 1; entry <= 0xFFFF; ++entry)
+        for (uint32_t desired = 0; desired < entry; desired += 1 + entry / 512) {
+            double exact = 65536.0 * desired / entry;
+            double err = std::fabs(Planner::ratio(entry, desired) - exact);
+            if (err > worst) {
+                worst = err;
+                worstEntry = entry;
+                worstDesired = desired;
+            }
+        }
+    printf("ratio: max error %.2f LSB of Q16 (entry %u, desired %u)\n",
+            worst, worstEntry, worstDesired);
+
+    //Speed, full input range in steps, response time 0..5 ms
+    Planner planner;
+    uint32_t calls = 0, sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t entry = 1; entry <= 0xFFFF; entry += 7)
+        for (uint32_t desired = 0; desired <= 0xFFFF; desired += 97) {
+            Pulse p = planner.plan(entry, (entry + desired) % 5000, desired);
+            sink += p.open;
+            ++calls;
+        }
+    auto t1 = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+    printf("plan: %u calls, %.2f ns/call (checksum %u)\n", calls, ns / calls, sink);
+    return 0;
+}
@@ -0,0 +1,135 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+//Gain schedule benchmark: fixed-point interpolation against float over
+//the whole scheduling range and across full-scale steps, how the eased
+//gains follow a table swap, and time per update against table size
+
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+
+#include "Control/schedule.h"
+
+//Position loop over throttle: softer at low thrust, stiffer at high
+constexpr GainTable<4> flight { 400, 8, 0, 4, {
+    {     0, 24000,  6000, 0 },
+    { 16384, 36000, 14000, 0 },
+    { 45000, 52000, 30000, 0 },
+    { 65535, 65535, 40000, 0 } } };
+static_assert(flight.valid(), "breakpoints must rise");
+
+//Every gain swings over its whole range, the widest interpolation there is
+constexpr GainTable<2> swing { 1, 1, 1, 2, {
+    {     0,     0, 65535, 65535 },
+    { 65535, 65535,     0,     0 } } };
+
+template< int N >
+static void ramp (GainTable<N>& t) {
+    t.kp = 400;
+    t.ki = 8;
+    t.kd = 1;
+    t.count = N;
+    for (int i = 0; i < N; ++i) {
+        double x = (double) i / (N - 1);
+        t.point[i].at = 65535 * x * x;
+        t.point[i].kp = 65535 * (0.3 + 0.7 * x);
+        t.point[i].ki = 65535 * x;
+        t.point[i].kd = 65535 * (1 - x);
+    }
+}
+
+//Largest difference to interpolating the same points in double, Q16 LSB
+template< int N >
+static double accuracy (GainTable<N> const& t) {
+    double worst = 0;
+    for (uint32_t x = 0; x <= 0xFFFF; ++x) {
+        uint16_t g [3];
+        GainSchedule<N>::lookup(t, x, g);
+        int i = 0;
+        while (i < t.count - 2 && t.point[i+1].at <= x)
+            ++i;
+        GainPoint const& a = t.point[i];
+        GainPoint const& b = t.point[i+1];
+        double f = std::fmin(1, std::fmax(0, ((double) x - a.at) / (b.at - a.at)));
+        worst = std::fmax(worst, std::fabs(g[0] - (a.kp + f * (b.kp - a.kp))));
+        worst = std::fmax(worst, std::fabs(g[1] - (a.ki + f * (b.ki - a.ki))));
+        worst = std::fmax(worst, std::fabs(g[2] - (a.kd + f * (b.kd - a.kd))));
+    }
+    return worst;
+}
+
+template< int N >
+static double timeIt (GainTable<N> const& t) {
+    constexpr int calls = 10000000;
+    GainSchedule<N> s;
+    s.init(&t, 0.02f);
+    volatile float sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; ++i) {
+        s.update(i * 40503u);
+        sink = s.kp;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    (void) sink;
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / calls;
+}
+
+static GainTable<4> small;
+static GainTable<16> medium;
+static GainTable<64> large;
+
+int main () {
+    ramp(small);
+    ramp(medium);
+    ramp(large);
+    printf("interpolation: max error %.2f / %.2f / %.2f / %.2f LSB (flight, 4, 16, 64 points)\n",
+            accuracy(flight), accuracy(small), accuracy(medium), accuracy(large));
+    printf("full-scale swing: max error %.2f LSB\n", accuracy(swing));
+
+    //Swap tables at half throttle, the eased kp closes in over a few ticks
+    GainSchedule<4> s;
+    s.init(&flight, 0.05f);
+    s.update(32768);
+    float from = s.kp;
+    uint16_t g [3];
+    GainSchedule<4>::lookup(small, 32768, g);
+    float to = small.kp * g[0] / 65536;
+    s.use(&small);
+    double step = 0;
+    float last = from;
+    int ticks = 0;
+    while (std::fabs(s.kp - to) > 0.01 * std::fabs(to - from) && ticks < 1000) {
+        s.update(32768);
+        step = std::fmax(step, std::fabs(s.kp - last));
+        last = s.kp;
+        ++ticks;
+    }
+    printf("table swap: kp %.1f -> %.1f, largest step %.2f per tick, 99%% there in %d ticks\n",
+            from, to, step, ticks);
+
+    printf("update: %.2f / %.2f / %.2f / %.2f ns (flight, 4, 16, 64 points)\n",
+            timeIt(flight), timeIt(small), timeIt(medium), timeIt(large));
+    return 0;
+}
@@ -0,0 +1,108 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+//Sensor calibration benchmark: chip temperature, supply divider and a
+//ratiometric pressure sensor read through SensorBank's integer lines,
+//across supplies from 3.0 to 3.6 V, against the exact values and against
+//the same conversions in double, as ADC::temperature() used to do them,
+//and time per conversion of both. On the M4 the double ones are software
+//floating point, hundreds of cycles each, the host only shows the rest
+
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+
+#include "Control/sensor.h"
+
+//Typical factory calibration: VREFINT 1.21 V, sensor 0.76 V at 25 C and
+//2.5 mV/C, all read at 3.3 V
+constexpr double VREFINT = 1.21, V25 = 0.76, SLOPE = 0.0025, CAL_SUPPLY = 3.3;
+constexpr double DIVIDER = 11;      //supply divider, 11:1
+constexpr double KPA = 1000;        //pressure at 90 % of VDDA, 0 kPa at 10 %
+
+enum { TEMP, SUPPLY, PRESSURE };
+
+static uint16_t counts (double volts, double vdda) { return (uint16_t) lround(volts / vdda * 4095); }
+
+int main () {
+    uint16_t vrefCal = counts(VREFINT, CAL_SUPPLY);
+    uint16_t cal30 = counts(V25 + 5 * SLOPE, CAL_SUPPLY), cal110 = counts(V25 + 85 * SLOPE, CAL_SUPPLY);
+
+    SensorBank<3> bank;
+    bank.init(3300, vrefCal);
+    bank.chipTemperature(TEMP, cal30, cal110);
+    bank.line(SUPPLY, 0, 0, 4095, 3300 * DIVIDER, true);
+    bank.line(PRESSURE, 410, 0, 3686, KPA * 1000, false);
+
+    double worst [3] = {}, worstDouble = 0;
+    for (double vdda = 3.0; vdda <= 3.6; vdda += 0.05) {
+        uint16_t vref = counts(VREFINT, vdda);
+        bank.refresh(vref);
+        for (double c = -40; c <= 125; c += 5) {
+            uint16_t raw = counts(V25 + (c - 25) * SLOPE, vdda);
+            double t = bank.read(TEMP, raw) / 1000.0;
+            worst[TEMP] = fmax(worst[TEMP], fabs(t - c));
+            //the double version of the same two-point line
+            double scaled = (double) raw * vrefCal / vref;
+            double d = 30 + (scaled - cal30) * 80 / (cal110 - cal30);
+            worstDouble = fmax(worstDouble, fabs(d - c));
+        }
+        for (double bus = 20; bus <= 30; bus += 0.5) {
+            double mv = bank.read(SUPPLY, counts(bus / DIVIDER, vdda));
+            worst[SUPPLY] = fmax(worst[SUPPLY], fabs(mv - 1000 * bus));
+        }
+        for (double kpa = 0; kpa <= KPA; kpa += 50) {
+            double pa = bank.read(PRESSURE, counts((0.1 + 0.8 * kpa / KPA) * vdda, vdda));
+            worst[PRESSURE] = fmax(worst[PRESSURE], fabs(pa - 1000 * kpa));
+        }
+    }
+    printf("VDDA 3.0..3.6 V, worst errors: temperature %.2f C (double %.2f C), "
+            "24 V supply %.0f mV, pressure %.2f kPa\n",
+            worst[TEMP], worstDouble, worst[SUPPLY], worst[PRESSURE] / 1000);
+    bank.refresh(vrefCal);
+    printf("refresh at VDDA 3.3 V: supply %u mV\n", bank.supply);
+
+    constexpr int N = 4096, REPS = 2000;
+    static uint16_t raw [N];
+    for (int i = 0; i < N; ++i)
+        raw[i] = 900 + i % 400;
+    volatile int32_t sinkI = 0;
+    volatile double sinkD = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < REPS; ++r)
+        for (int i = 0; i < N; ++i)
+            sinkI = bank.read(TEMP, raw[i]);
+    auto t1 = std::chrono::steady_clock::now();
+    volatile double vref = vrefCal;
+    for (int r = 0; r < REPS; ++r)
+        for (int i = 0; i < N; ++i)
+            sinkD = ((raw[i] * (CAL_SUPPLY * vrefCal / vref) / 4095 - V25) / SLOPE) + 25;
+    auto t2 = std::chrono::steady_clock::now();
+    (void) sinkI;
+    (void) sinkD;
+    printf("integer %.2f ns, double %.2f ns per conversion\n",
+            std::chrono::duration<double, std::nano>(t1 - t0).count() / (N * REPS),
+            std::chrono::duration<double, std::nano>(t2 - t1).count() / (N * REPS));
+    return 0;
+}
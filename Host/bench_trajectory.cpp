@@ -0,0 +1,98 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+//Trajectory benchmark: velocity, acceleration and jerk of the generated
+//setpoints against their limits, overshoot and settling on steps of
+//several sizes, fixed point against float, and time per update
+
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+
+#include "Control/trajectory.h"
+
+constexpr int RATE = 1000;                          //tick rate, Hz
+constexpr double VEL = 1, ACCEL = 20, JERK = 1000;  //rad/s, rad/s^2, rad/s^3
+constexpr double UNIT = 10e-6;                      //fixed point unit, rad
+
+typedef CurveMath<int32_t> Fixed;
+
+//One step from rest, then back halfway
+static void step (double size) {
+    SCurve<float> f;
+    SCurve<int32_t> q;
+    f.init(VEL, ACCEL, JERK, RATE);
+    q.init(VEL / UNIT, ACCEL / UNIT, JERK / UNIT, RATE);
+    f.reset(0);
+    q.reset(0);
+
+    double a = 0, vMax = 0, aMax = 0, jMax = 0, peak = 0, diff = 0;
+    int settled = -1;
+    for (int n = 0; n < RATE; ++n) {
+        double target = n < RATE / 2 ? size : size / 2;
+        double x = f.update(target);
+        double xq = Fixed::to(q.update(Fixed::from(target / UNIT))) * UNIT;
+        double nv = f.v * RATE, na = f.a * RATE * RATE;
+        vMax = std::fmax(vMax, std::fabs(nv));
+        aMax = std::fmax(aMax, std::fabs(na));
+        jMax = std::fmax(jMax, std::fabs(na - a) * RATE);
+        diff = std::fmax(diff, std::fabs(xq - x));
+        if (n < RATE / 2) {
+            peak = std::fmax(peak, x);
+            if (settled < 0 && std::fabs(x - size) < 1e-6)
+                settled = n;
+        }
+        a = na;
+    }
+    printf("step %.3f rad: peak v %.2f a %.1f j %.0f, overshoot %.2e rad, "
+           "settled in %d ms, fixed vs float %.1e rad\n",
+            size, vMax, aMax, jMax, peak - size, settled, diff);
+}
+
+//Time per update, target jumping between steps
+template< typename T >
+static double timeIt (double unit) {
+    constexpr int calls = 10000000;
+    SCurve<T> s;
+    s.init(VEL / unit, ACCEL / unit, JERK / unit, RATE);
+    s.reset(0);
+    T in [4] = { CurveMath<T>::from(0.1 / unit), CurveMath<T>::from(-0.05 / unit),
+                 CurveMath<T>::from(0.12 / unit), CurveMath<T>::from(0) };
+    volatile T sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; ++i)
+        sink = s.update(in[(i >> 9) & 3]);
+    auto t1 = std::chrono::steady_clock::now();
+    (void) sink;
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / calls;
+}
+
+int main () {
+    printf("limits: v %.2f a %.1f j %.0f\n", VEL, ACCEL, JERK);
+    const double sizes [] = { 0.001, 0.01, 0.05, 0.14 };
+    for (double size : sizes)
+        step(size);
+    printf("update: float %.2f ns, fixed %.2f ns\n", timeIt<float>(1), timeIt<int32_t>(UNIT));
+    return 0;
+}
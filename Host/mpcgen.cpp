@@ -0,0 +1,88 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+
+//Writes an explicit MPC table for Control/mpc.h as a C++ header, all
+//const so it lands in flash. Include it once in the firmware and hand
+//&mpcTable to Cascade::predictive()
+//usage: mpcgen [file [horizon [lag_ms]]], default build/mpc_table.h
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mpcgen.h"
+
+int main (int argc, char** argv) {
+    char const* file = argc > 1 ? argv[1] : "build/mpc_table.h";
+    MpcParams p;
+    if (argc > 2)
+        p.horizon = atoi(argv[2]);
+    if (argc > 3)
+        p.lag = atof(argv[3]) * 1e-3;
+    if (p.horizon < 1 || p.horizon > 15 || p.lag <= 0) {
+        fprintf(stderr, "horizon 1..15 blocks, lag > 0 ms\n");
+        return 1;
+    }
+
+    MpcBuild b;
+    b.build(p);
+    FILE* f = fopen(file, "w");
+    if (!f) {
+        perror(file);
+        return 1;
+    }
+
+    fprintf(f, "//Generated by Host/mpcgen, do not edit\n");
+    fprintf(f, "//period %g ms, lag %g ms, %d blocks of %d ticks, stroke %g mm, rate %g m/s\n",
+            p.period * 1e3, p.lag * 1e3, p.horizon, p.block, p.stroke * 1e3, p.rate);
+    fprintf(f, "//%zu regions, %zu rows, from %d of %d grid samples\n\n",
+            b.hits.size(), b.rows.size() / 4, b.samples - b.infeasible, b.samples);
+    fprintf(f, "#include \"Control/mpc.h\"\n\n");
+
+    fprintf(f, "static uint16_t const mpcFirst [] = {");
+    for (size_t i = 0; i < b.first.size(); ++i)
+        fprintf(f, "%s%u", i == 0 ? "\n    " : i % 16 ? ", " : ",\n    ", b.first[i]);
+    fprintf(f, "\n};\n\n");
+
+    auto quads = [f](char const* name, std::vector<float> const& v) {
+        fprintf(f, "static float const %s [][4] = {\n", name);
+        for (size_t i = 0; i < v.size(); i += 4) {
+            for (int j = 0; j < 4; ++j)
+                fprintf(f, "%s%.8ef", j ? ", " : "    { ", v[i + j]);
+            fprintf(f, " },\n");
+        }
+        fprintf(f, "};\n\n");
+    };
+    quads("mpcRows", b.rows);
+    quads("mpcLaw", b.law);
+
+    fprintf(f, "static MpcTable const mpcTable = {\n    %.8ef, %.8ef, %.8ef, %.8ef, %zu,\n"
+               "    mpcFirst, mpcRows, mpcLaw\n};\n",
+            1000.0, p.stroke, p.rate, p.period, b.hits.size());
+    fclose(f);
+
+    size_t bytes = b.first.size() * 2 + (b.rows.size() + b.law.size()) * 4;
+    printf("%s: %zu regions, %zu rows, %zu bytes\n", file, b.hits.size(), b.rows.size() / 4, bytes);
+    return 0;
+}
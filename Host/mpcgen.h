@@ -0,0 +1,545 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+
+//Explicit MPC generator, the tables read by Control/mpc.h
+//Model of one actuator under its velocity loop, per position loop tick:
+//  v' = (u - v) / lag, p' = v, u the velocity setpoint
+//Each setpoint is held for block ticks, horizon blocks are planned. The
+//cost is q (p - target)^2 at the end of every block plus rho u^2, with
+//|u| <= rate and |p| <= stroke at every block end, and after the first
+//tick too, else the rod can run over between block ends (the plan is
+//redone every tick, only the next one has to be safe). Condensed, that
+//is a QP in the setpoints U whose linear term and limits are affine in
+//theta = (p, v, target):
+//  min 1/2 U'HU + theta'F'U  subject to  G U <= W + S theta
+//
+//The explicit solution is found the practical way: the QP is solved on
+//a grid over the states that matter (Hildreth's dual coordinate descent,
+//simple and exact enough in double), and each distinct set of active
+//constraints met becomes a region. Its law and its inequalities follow
+//from the KKT conditions of that set, then rows that can't bind within
+//the sampled box are dropped (vertex enumeration, it's only 3-D). The
+//QP is solved again just beyond every remaining row, which finds the
+//neighbours the grid missed, until no new region turns up.
+//Positions are in mm inside the tables, velocities in m/s
+
+#ifndef HOST_MPCGEN_
+#define HOST_MPCGEN_
+
+#include <algorithm>
+#include <math.h>
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+#include "Control/mpc.h"
+
+struct MpcParams {
+    double period = 0.002;      //position loop tick, s
+    double lag = 0.010;         //velocity loop time constant, s
+    int block = 5;              //ticks each setpoint is held
+    int horizon = 4;            //blocks planned
+    double stroke = 0.008;      //+/- about the centre, m
+    double rate = 0.2;          //velocity setpoint limit, m/s
+    double q = 1, rho = 0.05;   //weights, per mm^2 and per (m/s)^2
+    double reach = 1.25;        //targets sampled out to reach * stroke
+    int grid = 24;              //samples along each axis of theta
+};
+
+//Small dense matrices, row-major
+struct MpcMat {
+    int rows, cols;
+    std::vector<double> a;
+
+    MpcMat (int r =0, int c =0) : rows (r), cols (c), a (r * c) {}
+    double& operator() (int i, int j) { return a[i * cols + j]; }
+    double operator() (int i, int j) const { return a[i * cols + j]; }
+
+    MpcMat operator* (MpcMat const& b) const {
+        MpcMat m (rows, b.cols);
+        for (int i = 0; i < rows; ++i)
+            for (int j = 0; j < b.cols; ++j)
+                for (int k = 0; k < cols; ++k)
+                    m(i, j) += (*this)(i, k) * b(k, j);
+        return m;
+    }
+
+    MpcMat t () const {
+        MpcMat m (cols, rows);
+        for (int i = 0; i < rows; ++i)
+            for (int j = 0; j < cols; ++j)
+                m(j, i) = (*this)(i, j);
+        return m;
+    }
+
+    //Gauss-Jordan with partial pivoting, false if singular
+    bool inverse (MpcMat& inv) const {
+        int n = rows;
+        MpcMat m = *this;
+        inv = MpcMat(n, n);
+        for (int i = 0; i < n; ++i)
+            inv(i, i) = 1;
+        for (int c = 0; c < n; ++c) {
+            int p = c;
+            for (int r = c + 1; r < n; ++r)
+                if (fabs(m(r, c)) > fabs(m(p, c)))
+                    p = r;
+            if (fabs(m(p, c)) < 1e-12)
+                return false;
+            for (int k = 0; k < n; ++k) {
+                std::swap(m(c, k), m(p, k));
+                std::swap(inv(c, k), inv(p, k));
+            }
+            double d = 1 / m(c, c);
+            for (int k = 0; k < n; ++k) {
+                m(c, k) *= d;
+                inv(c, k) *= d;
+            }
+            for (int r = 0; r < n; ++r)
+                if (r != c && m(r, c) != 0) {
+                    double f = m(r, c);
+                    for (int k = 0; k < n; ++k) {
+                        m(r, k) -= f * m(c, k);
+                        inv(r, k) -= f * inv(c, k);
+                    }
+                }
+        }
+        return true;
+    }
+};
+
+struct MpcBuild {
+    MpcParams p;
+    int n, m;                   //setpoints, constraints
+    MpcMat H, Hi, F, G, S, P, GHiF;
+    std::vector<double> W;
+
+    //the table, in the layout of MpcTable
+    std::vector<uint16_t> first;
+    std::vector<float> rows, law;   //4 floats each
+    std::vector<uint32_t> hits;     //grid samples per region
+    int samples = 0, infeasible = 0, dropped = 0;
+
+    MpcTable table () const {
+        MpcTable t;
+        t.unit = 1000;
+        t.stroke = p.stroke;
+        t.rate = p.rate;
+        t.period = p.period;
+        t.regions = hits.size();
+        t.first = first.data();
+        t.rows = (float const (*)[4]) rows.data();
+        t.law = (float const (*)[4]) law.data();
+        return t;
+    }
+
+    //The condensed QP
+    void model () {
+        n = p.horizon;
+        m = 4 * n + 2;
+        double T = p.period * 1e3, tau = p.lag * 1e3;   //ms
+        double a = exp(-T / tau);
+        MpcMat A (2, 2), B (2, 1);
+        A(0, 0) = 1;
+        A(0, 1) = tau * (1 - a);
+        A(1, 1) = a;
+        B(0, 0) = T - tau * (1 - a);
+        B(1, 0) = 1 - a;
+
+        //one block: Ab = A^block, Bb = sum A^i B
+        MpcMat Ab (2, 2), Bb (2, 1), Ai (2, 2);
+        Ab(0, 0) = Ab(1, 1) = Ai(0, 0) = Ai(1, 1) = 1;
+        for (int i = 0; i < p.block; ++i) {
+            MpcMat s = Ai * B;
+            Bb(0, 0) += s(0, 0);
+            Bb(1, 0) += s(1, 0);
+            Ai = Ai * A;
+        }
+        Ab = Ai;
+
+        //block-end positions: Gam (p, v) + Phi U
+        MpcMat Phi (n, n), Gam (n, 2), Ak = Ab;
+        std::vector<MpcMat> powers (1, MpcMat(2, 2));
+        powers[0](0, 0) = powers[0](1, 1) = 1;
+        for (int k = 0; k < n; ++k) {
+            Gam(k, 0) = Ak(0, 0);
+            Gam(k, 1) = Ak(0, 1);
+            Ak = Ak * Ab;
+            powers.push_back(powers.back() * Ab);
+            for (int j = 0; j <= k; ++j)
+                Phi(k, j) = (powers[k - j] * Bb)(0, 0);
+        }
+
+        //cost
+        H = MpcMat(n, n);
+        MpcMat PtP = Phi.t() * Phi;
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < n; ++j)
+                H(i, j) = 2 * (p.q * PtP(i, j) + (i == j ? p.rho : 0));
+        MpcMat E (n, 3);
+        for (int k = 0; k < n; ++k) {
+            E(k, 0) = Gam(k, 0);
+            E(k, 1) = Gam(k, 1);
+            E(k, 2) = -1;
+        }
+        F = Phi.t() * E;
+        for (double& v : F.a)
+            v *= 2 * p.q;
+
+        //limits
+        double s = p.stroke * 1e3;
+        G = MpcMat(m, n);
+        S = MpcMat(m, 3);
+        W.assign(m, 0);
+        for (int k = 0; k < n; ++k) {
+            G(k, k) = 1;
+            G(n + k, k) = -1;
+            W[k] = W[n + k] = p.rate;
+            for (int j = 0; j < n; ++j) {
+                G(2*n + k, j) = Phi(k, j);
+                G(3*n + k, j) = -Phi(k, j);
+            }
+            W[2*n + k] = W[3*n + k] = s;
+            S(2*n + k, 0) = -Gam(k, 0);
+            S(2*n + k, 1) = -Gam(k, 1);
+            S(3*n + k, 0) = Gam(k, 0);
+            S(3*n + k, 1) = Gam(k, 1);
+        }
+        G(4*n, 0) = B(0, 0);
+        G(4*n + 1, 0) = -B(0, 0);
+        W[4*n] = W[4*n + 1] = s;
+        for (int j = 0; j < 2; ++j) {
+            S(4*n, j) = -A(0, j);
+            S(4*n + 1, j) = A(0, j);
+        }
+
+        H.inverse(Hi);
+        P = G * Hi * G.t();
+        GHiF = G * Hi * F;
+    }
+
+    //Active constraints at theta, or -1 if there's no feasible plan
+    //l - the multipliers, in as the starting point and out as solved
+    int64_t solve (double const* theta, std::vector<double>& l) const {
+        std::vector<double> d (m);
+        l.resize(m);
+        for (int i = 0; i < m; ++i) {
+            d[i] = W[i];
+            for (int j = 0; j < 3; ++j)
+                d[i] += (S(i, j) + GHiF(i, j)) * theta[j];
+        }
+        for (int it = 0; it < 20000; ++it) {
+            double change = 0;
+            for (int i = 0; i < m; ++i) {
+                double g = d[i];
+                for (int j = 0; j < m; ++j)
+                    g += P(i, j) * l[j];
+                double v = std::max(0.0, l[i] - g / P(i, i));
+                change = std::max(change, fabs(v - l[i]));
+                l[i] = v;
+            }
+            if (change < 1e-13)
+                break;
+        }
+
+        //U = -Hi (F theta + G' l), then check the limits
+        std::vector<double> r (n, 0), u (n, 0);
+        for (int i = 0; i < n; ++i) {
+            for (int j = 0; j < 3; ++j)
+                r[i] += F(i, j) * theta[j];
+            for (int j = 0; j < m; ++j)
+                r[i] += G(j, i) * l[j];
+        }
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < n; ++j)
+                u[i] -= Hi(i, j) * r[j];
+        int64_t active = 0;
+        for (int i = 0; i < m; ++i) {
+            double g = -W[i];
+            for (int j = 0; j < n; ++j)
+                g += G(i, j) * u[j];
+            for (int j = 0; j < 3; ++j)
+                g -= S(i, j) * theta[j];
+            if (g > 1e-6)
+                return -1;
+            if (l[i] > 1e-9)
+                active |= (int64_t) 1 << i;
+        }
+        return active;
+    }
+
+    //Law and inequalities of one active set, false if degenerate
+    bool region (int64_t active, double law [4], std::vector<double>& ineq) const {
+        std::vector<int> on;
+        for (int i = 0; i < m; ++i)
+            if (active >> i & 1)
+                on.push_back(i);
+        int na = on.size();
+
+        MpcMat K (n, 3), L (na, 3);
+        std::vector<double> k (n, 0), lc (na, 0);
+        if (na > 0) {
+            MpcMat Ga (na, n), Sa (na, 3), Mi;
+            for (int a = 0; a < na; ++a) {
+                for (int j = 0; j < n; ++j)
+                    Ga(a, j) = G(on[a], j);
+                for (int j = 0; j < 3; ++j)
+                    Sa(a, j) = S(on[a], j);
+            }
+            if (!(Ga * Hi * Ga.t()).inverse(Mi))
+                return false;
+            //lambda = L theta + lc = -Mi (Sa theta + Ga Hi F theta + Wa)
+            MpcMat T = Ga * Hi * F;
+            for (int a = 0; a < na; ++a)
+                for (int j = 0; j < 3; ++j)
+                    T(a, j) += Sa(a, j);
+            L = Mi * T;
+            for (double& v : L.a)
+                v = -v;
+            for (int a = 0; a < na; ++a)
+                for (int b = 0; b < na; ++b)
+                    lc[a] -= Mi(a, b) * W[on[b]];
+            //U = -Hi (F theta + Ga' lambda)
+            MpcMat GtL = Ga.t() * L;
+            for (int i = 0; i < n; ++i)
+                for (int j = 0; j < 3; ++j)
+                    GtL(i, j) += F(i, j);
+            K = Hi * GtL;
+            std::vector<double> g (n, 0);
+            for (int i = 0; i < n; ++i)
+                for (int a = 0; a < na; ++a)
+                    g[i] += Ga(a, i) * lc[a];
+            for (int i = 0; i < n; ++i)
+                for (int j = 0; j < n; ++j)
+                    k[i] -= Hi(i, j) * g[j];
+            for (double& v : K.a)
+                v = -v;
+        } else {
+            K = Hi * F;
+            for (double& v : K.a)
+                v = -v;
+        }
+
+        for (int j = 0; j < 3; ++j)
+            law[j] = K(0, j);
+        law[3] = k[0];
+
+        //lambda >= 0, and the inactive limits hold
+        ineq.clear();
+        for (int a = 0; a < na; ++a) {
+            for (int j = 0; j < 3; ++j)
+                ineq.push_back(-L(a, j));
+            ineq.push_back(lc[a]);
+        }
+        for (int i = 0; i < m; ++i) {
+            if (active >> i & 1)
+                continue;
+            double c [3] = {}, b = W[i];
+            for (int j = 0; j < n; ++j) {
+                for (int c3 = 0; c3 < 3; ++c3)
+                    c[c3] += G(i, j) * K(j, c3);
+                b -= G(i, j) * k[j];
+            }
+            for (int j = 0; j < 3; ++j)
+                ineq.push_back(c[j] - S(i, j));
+            ineq.push_back(b);
+        }
+
+        //scale rows to unit normals, so violations compare across regions
+        for (size_t r = 0; r < ineq.size(); r += 4) {
+            double s = sqrt(ineq[r] * ineq[r] + ineq[r+1] * ineq[r+1] + ineq[r+2] * ineq[r+2]);
+            if (s < 1e-12)
+                s = 1;
+            for (int j = 0; j < 4; ++j) {
+                ineq[r + j] /= s;
+                if (fabs(ineq[r + j]) < 1e-12)
+                    ineq[r + j] = 0;
+            }
+        }
+        return true;
+    }
+
+    //Vertices of {rows of all except skip}
+    static std::vector<double> vertices (std::vector<double> const& all, int skip) {
+        std::vector<double> out;
+        int count = all.size() / 4;
+        for (int i = 0; i < count; ++i)
+            for (int j = i + 1; j < count; ++j)
+                for (int k = j + 1; k < count; ++k) {
+                    if (i == skip || j == skip || k == skip)
+                        continue;
+                    double const* r [3] = { &all[4*i], &all[4*j], &all[4*k] };
+                    double det = r[0][0] * (r[1][1] * r[2][2] - r[1][2] * r[2][1]) -
+                                 r[0][1] * (r[1][0] * r[2][2] - r[1][2] * r[2][0]) +
+                                 r[0][2] * (r[1][0] * r[2][1] - r[1][1] * r[2][0]);
+                    if (fabs(det) < 1e-12)
+                        continue;
+                    //Cramer's rule
+                    double x [3];
+                    for (int c = 0; c < 3; ++c) {
+                        double m [3][3];
+                        for (int q = 0; q < 3; ++q)
+                            for (int s = 0; s < 3; ++s)
+                                m[q][s] = s == c ? r[q][3] : r[q][s];
+                        x[c] = (m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+                                m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                                m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0])) / det;
+                    }
+                    bool inside = true;
+                    for (int q = 0; q < count && inside; ++q)
+                        if (q != skip)
+                            inside = all[4*q] * x[0] + all[4*q+1] * x[1] +
+                                     all[4*q+2] * x[2] - all[4*q+3] <= 1e-9;
+                    if (inside)
+                        out.insert(out.end(), x, x + 3);
+                }
+        return out;
+    }
+
+    //The rows of a region with the sampled box around them
+    std::vector<double> boxed (std::vector<double> const& ineq) const {
+        double s = p.stroke * 1e3, t = p.reach * s, v = p.rate;
+        double box [6][4] = { { 1, 0, 0, s }, { -1, 0, 0, s }, { 0, 1, 0, v },
+                              { 0, -1, 0, v }, { 0, 0, 1, t }, { 0, 0, -1, t } };
+        std::vector<double> all (ineq);
+        for (auto& b : box)
+            all.insert(all.end(), b, b + 4);
+        return all;
+    }
+
+    //Drop the rows of a region that can't bind inside the sampled box:
+    //without the row, no vertex lies beyond it
+    void prune (std::vector<double>& ineq) const {
+        for (int r = ineq.size() / 4 - 1; r >= 0; --r) {
+            std::vector<double> v = vertices(boxed(ineq), r);
+            double const* a = &ineq[4*r];
+            double worst = -1e30;
+            for (size_t i = 0; i < v.size(); i += 3)
+                worst = std::max(worst, a[0] * v[i] + a[1] * v[i+1] + a[2] * v[i+2] - a[3]);
+            if (worst <= 1e-9)
+                ineq.erase(ineq.begin() + 4*r, ineq.begin() + 4*r + 4);
+        }
+    }
+
+    //Points just beyond each facet of a pruned region, where the
+    //neighbouring regions are: the mean of the facet's vertices, moved out
+    std::vector<double> beyond (std::vector<double> const& ineq) const {
+        std::vector<double> out, v = vertices(boxed(ineq), -1);
+        for (size_t r = 0; r < ineq.size(); r += 4) {
+            double const* a = &ineq[r];
+            double x [3] = {};
+            int on = 0;
+            for (size_t i = 0; i < v.size(); i += 3)
+                if (fabs(a[0] * v[i] + a[1] * v[i+1] + a[2] * v[i+2] - a[3]) < 1e-7) {
+                    for (int j = 0; j < 3; ++j)
+                        x[j] += v[i + j];
+                    ++on;
+                }
+            if (on < 3)
+                continue;
+            for (int j = 0; j < 3; ++j)
+                out.push_back(x[j] / on + 1e-5 * a[j]);
+        }
+        return out;
+    }
+
+    void build (MpcParams const& params) {
+        p = params;
+        model();
+
+        //solve on the grid, count the active sets met. Neighbours have
+        //much the same multipliers, each solve starts from the last
+        std::map<int64_t, uint32_t> sets;
+        std::vector<double> l;
+        double s = p.stroke * 1e3;
+        for (int i = 0; i < p.grid; ++i)
+            for (int j = 0; j < p.grid; ++j)
+                for (int k = 0; k < p.grid; ++k) {
+                    double theta [3] = {
+                        -s + 2 * s * (i + 0.5) / p.grid,
+                        -p.rate + 2 * p.rate * (j + 0.5) / p.grid,
+                        -p.reach * s + 2 * p.reach * s * (k + 0.5) / p.grid };
+                    ++samples;
+                    int64_t a = solve(theta, l);
+                    if (a < 0) {
+                        ++infeasible;
+                        l.assign(m, 0);
+                    }
+                    else
+                        ++sets[a];
+                }
+
+        //then cross the facets of each region found, a grid is bound to
+        //step over thin ones such as along the stroke limits
+        struct Region { uint32_t hits; double law [4]; std::vector<double> ineq; };
+        std::map<int64_t, Region> found;
+        std::vector<int64_t> todo;
+        for (auto& e : sets) {
+            found[e.first].hits = e.second;
+            todo.push_back(e.first);
+        }
+        while (!todo.empty() && found.size() < 2000) {
+            int64_t active = todo.back();
+            todo.pop_back();
+            Region& r = found[active];
+            if (!region(active, r.law, r.ineq)) {
+                ++dropped;
+                found.erase(active);
+                continue;
+            }
+            prune(r.ineq);
+            std::vector<double> x = beyond(r.ineq);
+            for (size_t i = 0; i < x.size(); i += 3) {
+                l.assign(m, 0);
+                int64_t a = solve(&x[i], l);
+                if (a >= 0 && !found.count(a)) {
+                    found[a].hits = 0;
+                    todo.push_back(a);
+                }
+            }
+        }
+
+        //most used first
+        std::vector<Region const*> order;
+        for (auto& e : found)
+            order.push_back(&e.second);
+        std::stable_sort(order.begin(), order.end(), [](Region const* a, Region const* b) {
+            return a->hits > b->hits;
+        });
+
+        first.assign(1, 0);
+        rows.clear();
+        law.clear();
+        hits.clear();
+        for (Region const* r : order) {
+            rows.insert(rows.end(), r->ineq.begin(), r->ineq.end());
+            law.insert(law.end(), r->law, r->law + 4);
+            hits.push_back(r->hits);
+            first.push_back(rows.size() / 4);
+        }
+    }
+};
+
+#endif //HOST_MPCGEN
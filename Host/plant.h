@@ -0,0 +1,256 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+//Plant models for host simulation: engine bell on a two-axis gimbal, the
+//two linear actuators that move it, the solenoid valves and a valve rig
+//SI units, double precision, fixed-step semi-implicit Euler. Independent
+//of the register layer, so instances can also be stepped directly
+//
+//Actuator: DC motor (R, L, Kt) on a lead screw. The nut drives the rod
+//through a stiff spring with a backlash gap, the rod is pinned to the
+//bell. Friction on the motor is viscous plus Coulomb, smoothed around 0
+//Bell: rigid body about the pivot, the actuator forces act through the
+//Jacobian of the gimbal kinematics in Control/kinematics.h
+
+#ifndef HOST_PLANT_
+#define HOST_PLANT_
+
+#include <math.h>
+
+#include "Control/kinematics.h"
+
+struct ActuatorParams {
+    double r = 0.5;             //winding resistance, ohm
+    double l = 0.2e-3;          //winding inductance, H
+    double kt = 0.03;           //torque and back-emf constant, Nm/A
+    double inertia = 5e-6;      //rotor and screw, kg m^2
+    double viscous = 2e-6;      //Nm s/rad
+    double coulomb = 0.01;      //Nm
+    double lead = 0.002;        //screw travel per turn, m
+    double stiffness = 2e6;     //nut to bell, N/m
+    double damping = 400;       //N s/m
+    double backlash = 20e-6;    //total gap, m
+    double bus = 24;            //supply, V
+};
+
+struct Actuator {
+    ActuatorParams p;
+    double amps = 0, speed = 0, angle = 0;  //motor state, A rad/s rad
+    double force = 0;                       //pushing the bell, N
+    bool seized = false;                    //jammed screw, the motor stalls
+
+    //nut travel per motor radian
+    double ratio () const { return p.lead / (2 * M_PI); }
+
+    //duty -1..1 across the winding, rod extension and speed from the bell
+    void step (double duty, double rod, double rodSpeed, double dt) {
+        double nut = angle * ratio(), gap = nut - rod, half = p.backlash / 2;
+        double squeeze = gap > half ? gap - half : gap < -half ? gap + half : 0;
+        force = squeeze != 0 ? p.stiffness * squeeze + p.damping * (speed * ratio() - rodSpeed) : 0;
+
+        //winding implicit in the current, stable at any step size,
+        //multiplied through by l for one division
+        amps = (amps * p.l + (duty * p.bus - p.kt * speed) * dt) / (p.l + p.r * dt);
+        //tanh(x): +-1 past 22, where the motor spends most steps, and through
+        //exp() below that, which costs a fraction of the tanh() call
+        double x = speed / 0.5, drag = x > 22 ? 1 : x < -22 ? -1 : 1 - 2 / (exp(2 * x) + 1);
+        double torque = p.kt * amps - p.viscous * speed - force * ratio() - p.coulomb * drag;
+        speed = seized ? 0 : speed + torque / p.inertia * dt;
+        angle += speed * dt;
+    }
+};
+
+struct BellParams {
+    double inertia = 0.02;      //about either axis, kg m^2
+    double damping = 0.05;      //pivot, Nm s/rad
+    double torque = 0.5;        //steady side load on pitch, e.g. thrust offset, Nm
+};
+
+struct Bell {
+    typedef BellGimbal G;
+
+    BellParams p;
+    double pitch = 0, yaw = 0, pitchRate = 0, yawRate = 0;
+    double jac [2][2] = {};     //d length / d angle, rows a, b
+
+    Bell () { relinearise(); }
+
+    struct DoubleMath {
+        static double sin (double x) { return ::sin(x); }
+        static double cos (double x) { return ::cos(x); }
+        static double sqrt (double x) { return ::sqrt(x); }
+    };
+
+    static ActuatorLengths lengths (double pitch, double yaw) {
+        return gimbalLengths<G,DoubleMath,double>(pitch, yaw);
+    }
+
+    void jacobian () {
+        constexpr double d = 1e-3;
+        ActuatorLengths p0 = lengths(pitch - d, yaw), p1 = lengths(pitch + d, yaw);
+        ActuatorLengths y0 = lengths(pitch, yaw - d), y1 = lengths(pitch, yaw + d);
+        jac[0][0] = (p1.a - p0.a) / (2 * d);
+        jac[0][1] = (y1.a - y0.a) / (2 * d);
+        jac[1][0] = (p1.b - p0.b) / (2 * d);
+        jac[1][1] = (y1.b - y0.b) / (2 * d);
+    }
+
+    //actuator a, b extensions from the neutral length, and their speeds
+    double rod (int i) const {
+        return jac[i][0] * pitch + jac[i][1] * yaw + (i ? offset.b : offset.a);
+    }
+    double rodSpeed (int i) const { return jac[i][0] * pitchRate + jac[i][1] * yawRate; }
+
+    //forces of actuators a and b, pushing
+    void step (double fa, double fb, double dt) {
+        //power balance: torque = J^T F, with F along the actuators
+        double tp = jac[0][0] * fa + jac[1][0] * fb + p.torque - p.damping * pitchRate;
+        double ty = jac[0][1] * fa + jac[1][1] * fb - p.damping * yawRate;
+        pitchRate += tp / p.inertia * dt;
+        yawRate += ty / p.inertia * dt;
+        pitch += pitchRate * dt;
+        yaw += yawRate * dt;
+    }
+
+    //linearisation around the present angles, redo every few steps
+    void relinearise () {
+        jacobian();
+        ActuatorLengths l = lengths(pitch, yaw);
+        offset.a = l.a - G::length - jac[0][0] * pitch - jac[0][1] * yaw;
+        offset.b = l.b - G::length - jac[1][0] * pitch - jac[1][1] * yaw;
+    }
+
+    ActuatorLengths offset {};
+};
+
+//Solenoid valve: the armature starts moving a dead time after the coil
+//switches, then takes "travel" to cross. The position switch closes to
+//ground when the valve is more than half open
+struct ValveParams {
+    double openDelay = 4e-3, closeDelay = 2.5e-3, travel = 1e-3; //s
+    double r = 4, l = 10e-3;    //coil, ohm H
+    double emf = 6e-3;          //back-EMF, V per travel per s
+};
+
+struct Valve {
+    ValveParams p;
+    double position = 0, since = 0;  //0 closed .. 1 open, time in coil state
+    bool coil = false;
+
+    void step (bool energised, double dt) {
+        if (energised != coil) {
+            coil = energised;
+            since = 0;
+        }
+        since += dt;
+        if (since > (coil ? p.openDelay : p.closeDelay)) {
+            position += (coil ? dt : -dt) / p.travel;
+            position = position < 0 ? 0 : position > 1 ? 1 : position;
+        }
+    }
+
+    bool open () const { return position > 0.5; }
+};
+
+//Cheap normal-ish noise, sum of four uniforms, unit variance
+struct Noise {
+    uint32_t s;
+
+    explicit Noise (uint32_t seed =1) : s (seed ? seed : 1) {}
+
+    double operator() () {
+        int32_t sum = 0;
+        for (int i = 0; i < 4; ++i) {
+            s ^= s << 13;
+            s ^= s >> 17;
+            s ^= s << 5;
+            sum += s >> 16;
+        }
+        return (sum - 4 * 32767.5) * (1.7320508 / 65536);
+    }
+};
+
+//12-bit ADC reading of a plant signal: counts = zero + value / scale
+//Rounded half up, as lround() does for the positive counts, without the call
+struct Sensor {
+    double scale, zero, noise;  //units per count, counts at 0, rms counts
+
+    uint16_t read (double value, Noise& rng) const {
+        double c = zero + value * (1 / scale) + noise * rng();
+        return c < 0 ? 0 : c > 4095 ? 4095 : (uint16_t) (c + 0.5);
+    }
+};
+
+//Valve test rig: the valve feeds a chamber from the entry flow, its
+//pressure follows the open fraction with the fill time constant. The
+//supply rail sags while the coil draws current, the chamber gas warms
+//while the valve is open and cools back to ambient
+struct RigParams {
+    double entry = 0.6;         //entry flow, fraction of the sensor's range
+    double kpa = 800;           //chamber pressure with the valve open
+    double fill = 0.05;         //s
+    double supply = 12, sag = 0.3;      //V, V with the coil on
+    double ambient = 25, heating = 20, cooling = 0.5;  //C, C/s open, 1/s
+};
+
+//The coil current follows the mean coil voltage, duty * supply, less the
+//back-EMF of the moving armature: it dips while the valve opens, and the
+//freewheel diode keeps it from going negative
+struct ValveRig {
+    RigParams p;
+    Valve valve;
+    double kpa = 0, volts = 12, celsius = 25, amps = 0;
+
+    void step (double duty, double dt) {
+        bool coil = duty > 0;
+        double was = valve.position;
+        valve.step(coil, dt);
+        //implicit in the current, multiplied through by l for one division
+        double l = valve.p.l, moved = valve.p.emf * (valve.position - was);
+        amps = (amps * l + duty * volts * dt - moved) / (l + valve.p.r * dt);
+        amps = amps > 0 ? amps : 0;
+        kpa += (valve.position * p.kpa - kpa) * dt / p.fill;
+        volts = p.supply - (coil ? p.sag : 0);
+        celsius += (valve.position * p.heating - (celsius - p.ambient) * p.cooling) * dt;
+    }
+};
+
+//Everything together, stepped with the PWM duties and the valve coil
+struct GimbalPlant {
+    Bell bell;
+    Actuator a, b;
+    Valve valve;
+    int steps = 0;
+
+    void step (double dutyA, double dutyB, bool coil, double dt) {
+        if (steps++ % 50 == 0)
+            bell.relinearise();
+        a.step(dutyA, bell.rod(0), bell.rodSpeed(0), dt);
+        b.step(dutyB, bell.rod(1), bell.rodSpeed(1), dt);
+        bell.step(a.force, b.force, dt);
+        valve.step(coil, dt);
+    }
+};
+
+#endif //HOST_PLANT
@@ -0,0 +1,117 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+//Work-stealing pool for independent jobs 0..count-1
+//Every worker starts with an equal block of job numbers in its own queue
+//and takes jobs from the back of it. A worker that runs dry steals the
+//front half of another worker's queue. Queues are ranges [lo, hi), so a
+//steal moves any number of jobs in O(1); jobs are expected to be coarse
+//(a whole simulation run), one mutex per queue is cheap enough
+
+#ifndef HOST_POOL_
+#define HOST_POOL_
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkPool {
+    struct Queue {
+        std::mutex lock;
+        int lo = 0, hi = 0;
+    };
+
+    std::vector<Queue> queues;
+
+    bool take (int w, int& job) {
+        Queue& q = queues[w];
+        std::lock_guard<std::mutex> g (q.lock);
+        if (q.lo >= q.hi)
+            return false;
+        job = --q.hi;
+        return true;
+    }
+
+    bool steal (int w) {
+        int n = queues.size();
+        for (int i = 1; i < n; ++i) {
+            Queue& v = queues[(w + i) % n];
+            int lo, hi;
+            {
+                std::lock_guard<std::mutex> g (v.lock);
+                int half = (v.hi - v.lo + 1) / 2;
+                if (half == 0)
+                    continue;
+                lo = v.lo;
+                hi = v.lo += half;
+            }
+            Queue& q = queues[w];
+            std::lock_guard<std::mutex> g (q.lock);
+            q.lo = lo;
+            q.hi = hi;
+            return true;
+        }
+        return false;
+    }
+
+public:
+    uint64_t steals = 0;
+
+    explicit WorkPool (int threads) : queues (threads > 0 ? threads : 1) {}
+
+    int size () const { return queues.size(); }
+
+    //Run job(index, worker) for every index, returns when all are done
+    template< typename F >
+    void run (int count, F job) {
+        int n = queues.size();
+        for (int w = 0; w < n; ++w) {
+            queues[w].lo = (int64_t) count * w / n;
+            queues[w].hi = (int64_t) count * (w + 1) / n;
+        }
+
+        std::vector<uint64_t> stolen (n);
+        auto worker = [&](int w) {
+            int j;
+            for (;;) {
+                while (take(w, j))
+                    job(j, w);
+                if (!steal(w))
+                    return;
+                ++stolen[w];
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (int w = 1; w < n; ++w)
+            threads.emplace_back(worker, w);
+        worker(0);
+        for (auto& t : threads)
+            t.join();
+        for (int w = 0; w < n; ++w)
+            steals += stolen[w];
+    }
+};
+
+#endif //HOST_POOL
@@ -0,0 +1,1210 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+//Simulated STM32F4 register layer for host builds of the firmware
+//MMIO32/16/8 become proxies, so every register access of the unmodified
+//JeeH and ECU code lands in Sim::read() / Sim::write(). The machine keeps
+//the peripheral address space in memory and models the side effects the
+//control code relies on:
+//  GPIO - BSRR sets/resets ODR, IDR mixes outputs with plant inputs
+//  timers - count in simulated time: update and compare events, one-pulse
+//      mode, repetition counter, preloaded compare registers, TRGO,
+//      center-aligned counting
+//  ADC - software and timer-triggered regular conversions of plant signals,
+//      scan sequences and continuous mode at the programmed sampling times,
+//      timer-triggered injected sequences, which restart a regular
+//      conversion they interrupt, triple interleaved mode with DMA mode 2
+//  DMA - peripheral to memory streams fed by the ADCs: circular and
+//      double-buffer modes, half and full transfer flags and interrupts
+//  EXTI - edges on plant inputs, NVIC - enables, priorities, vectors
+//  DWT - cycle counter
+//  flash - 1 MB at 0x08000000 in host memory, read through plain pointers
+//      as on the target, programming clears bits, sector erase sets them
+//Not modelled: software-started injected conversions, other multi-ADC
+//modes, other DMA requests, timer output pins (the plant reads the PWM
+//duty from duty(), or the level from compareOutput()), clocks (fixed at 168/84 MHz, the ADC clock follows
+//ADCPRE), flash timing and locking
+//
+//DMA writes go straight to host memory at the 32-bit addresses the code
+//programmed, so sims using DMA must be linked -no-pie, which keeps the
+//firmware's static buffers below 4 GB, and all of them above the flash,
+//see the Makefile, or the heap may sit where the flash is mapped
+//
+//Time is kept in core cycles. Events are processed in time order and due
+//interrupts run to completion in NVIC priority order, without nesting.
+//Code between register accesses takes no time, each access costs a few
+//cycles, which is what DWT and the timer counters see
+//
+//Speed goes with the number of events, each costs around 70 ns of host
+//time with the handlers it runs. Events nobody waits for are not made:
+//updates that only load a PWM duty, compare matches without an interrupt
+//or ADC trigger. What every event would otherwise pay for is kept until
+//the registers behind it change: the decoded ADC sequences, which ADCs a
+//timer triggers, the earliest timer and ADC event, whether a pin moved
+//for the EXTI. The gimbal, 110k events per simulated second, runs at
+//about 130x real time, with the continuous position scan added, 390k, at
+//about 45x, the valve program at about 190x and with peak-and-hold at
+//about 120x (one x86 core)
+//
+//Include this before anything else that includes jee.h, one machine per
+//process since the firmware keeps its state in static members
+
+#ifndef HOST_SIM_
+#define HOST_SIM_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <vector>
+
+namespace Sim {
+    inline uint32_t read (uint32_t addr, int size);
+    inline void write (uint32_t addr, uint32_t v, int size);
+}
+
+template< typename T >
+struct SimReg {
+    uint32_t addr;
+
+    //inlined, so the access sees its address as a constant, see Machine::read()
+    __attribute__((always_inline)) operator T () const { return Sim::read(addr, sizeof (T)); }
+    __attribute__((always_inline)) SimReg const& operator= (T v) const {
+        Sim::write(addr, v, sizeof (T));
+        return *this;
+    }
+    SimReg const& operator|= (T v) const { return *this = (T) (*this | v); }
+    SimReg const& operator&= (T v) const { return *this = (T) (*this & v); }
+    SimReg const& operator^= (T v) const { return *this = (T) (*this ^ v); }
+};
+
+#define MMIO32(x) (SimReg<uint32_t>{ (uint32_t) (x) })
+#define MMIO16(x) (SimReg<uint16_t>{ (uint32_t) (x) })
+#define MMIO8(x)  (SimReg<uint8_t>{ (uint32_t) (x) })
+
+#ifndef STM32F4
+#define STM32F4 1
+#define STM32F41X 1
+#endif
+
+#include "lib/jeeh-fork-master/jee.h"
+
+namespace Sim {
+
+constexpr uint32_t cpuHz = 168000000;
+constexpr uint64_t never = ~0ULL;
+
+//Cycles per register access, core and peripheral bus
+constexpr int accessCost = 2;
+
+//Timer number for each 0x400 slot of the APB1/APB2 timer area, 0 = none
+constexpr int timerAt (int slot) {
+    return slot < 9 ? (slot < 6 ? slot + 2 : slot + 6) :  // TIM2..7, 12..14
+           slot == 64 ? 1 : slot == 65 ? 8 :
+           slot >= 80 && slot <= 82 ? slot - 71 :         // TIM9..11
+           0;
+}
+
+struct TimerModel {
+    int n = 0;
+    uint32_t base = 0, tick = 1;    //core cycles per count, before psc
+    uint32_t* r = 0;                //the registers at base, in the machine's memory
+    int irq = 0, ccIrq = 0;
+    uint64_t origin = 0;            //time at which the count was 0
+    uint64_t cycle = 0;             //start of the last cycle found, see cycleStart()
+    uint64_t cycleOrigin = ~0ULL, cyclePeriod = 0;  //and the timing it was found for
+    uint64_t seen = 0;              //periods already flagged in sr
+    uint32_t psc = 0, ccr [4] = {}; //active (shadow) values
+    bool preload [4] = {};          //ccr written, waiting for an update
+    uint64_t loadAt = ~0ULL;        //update that loads them, unless one is handled
+    bool ref [4] = {};              //OCxREF held by the on-match modes
+    int rep = 0;
+    //schedule worked out from the registers, redone when "replan" is set
+    bool replan = true, updates = false;
+    uint64_t period = 0, interval = 0;
+    uint8_t compares = 0;           //channels with compare events, bit ch
+    int phases = 0;
+    uint64_t phase [8] = {};        //compare times within a period
+    uint8_t channel [8] = {};
+
+    uint32_t& at (uint32_t off) { return r[off / 4]; }
+};
+
+//Regular or injected sequence of an ADC as its registers set it: the
+//channels, the cycles from start to end of conversion of each and how
+//many are converted
+struct Sequence {
+    uint8_t chan [16];
+    uint32_t cycles [16];
+    int length;
+    uint32_t total;             //cycles for all of them, kept for the injected one
+};
+
+struct Machine {
+    std::vector<uint32_t> periph, core;
+    uint64_t now = 0, cpu = 0;      //event time, and time seen by code
+    uint64_t cycBase = 0;
+    TimerModel tim [15];
+    uint64_t due [15];              //next event of each timer
+    uint64_t soonest = never;       //the earliest of them
+    uint32_t timing = 0;            //timers with an event due, bit n
+    uint32_t stale = ~0U;           //timers whose next event needs working out
+    uint32_t armed = 0;             //timers with interrupts enabled in dier
+    uint32_t flagged = 0;           //timers that may have a flag set in sr
+    uint8_t linked [15] = {};       //timer events that trigger an ADC, bit 0 TRGO
+    uint8_t regularBy [15][5] = {}, injectedBy [15][5] = {};  //ADCs they start, bit adc
+    bool raised = true;             //an enabled flag was set or the code wrote, see dispatch()
+    uint32_t adcArmed = 0;          //ADCs with EOCIE or JEOCIE set, bit 0 = ADC1
+    uint64_t adcDue [4] = { never, never, never, never };  //next conversion end
+    uint64_t injectDue [4] = { never, never, never, never };  //injected sequence end
+    int adcSeq [4] = {};            //position in the scan sequence
+    Sequence adcRegular [4], adcInjected [4];  //see regular()
+    uint32_t adcFresh = 0;          //ADCs whose sequence is up to date, bit adc
+    uint16_t pairLow = 0;           //first sample of a word in interleaved mode
+    uint16_t dmaCount [16] = {};    //ndtr at enable, DMA1 streams 0..7 then DMA2
+    uint32_t dmaArmed = 0;          //streams with interrupts enabled
+    uint32_t dmaOn = 0;             //enabled streams
+    uint16_t level [11] = {}, driven [11] = {};
+    uint16_t extiLast = 0;
+    bool pinsMoved = true;          //a pin, or how the EXTI sees it, may have changed
+    uint8_t* flash = 0;             //mapped at its own address, or 0
+    VTable vtable {};
+
+    //plant hooks: a conversion of ADC adc (1..3), channel chan, 12 bits
+    uint16_t (*analog) (int adc, int chan) = 0;
+
+    Machine () : periph (0x80000 / 4), core (0x100000 / 4) {
+        for (int n = 1; n <= 14; ++n) {
+            TimerModel& t = tim[n];
+            t.n = n;
+            bool apb2 = n == 1 || n == 8 || (n >= 9 && n <= 11);
+            t.tick = apb2 ? 1 : 2;
+        }
+        setupTimer<1>(); setupTimer<2>(); setupTimer<3>(); setupTimer<4>();
+        setupTimer<5>(); setupTimer<6>(); setupTimer<7>(); setupTimer<8>();
+        setupTimer<9>(); setupTimer<10>(); setupTimer<11>(); setupTimer<12>();
+        setupTimer<13>(); setupTimer<14>();
+        void* at = mmap((void*) (uintptr_t) flashBase, flashSize, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+        if (at == (void*) (uintptr_t) flashBase) {
+            flash = (uint8_t*) at;
+            memset(flash, 0xFF, flashSize);
+        }
+    }
+
+    constexpr static uint32_t flashBase = 0x08000000, flashSize = 0x100000;
+
+    //FLASH_CR: PG programs what is written to flash, SER with STRT erases
+    //sector SNB, 16/16/16/16/64/128... KB
+    void flashWrite (uint32_t a, uint32_t v, int size) {
+        if (flash == 0)
+            fatal("flash not mapped", a);
+        if (!(word(Flash::cr) & 1))
+            fatal("flash write without PG", a);
+        uint8_t* p = flash + (a - flashBase);
+        for (int i = 0; i < size; ++i)
+            p[i] &= v >> 8 * i;
+    }
+
+    void flashControl (uint32_t v) {
+        if ((v & (1 << 16)) && (v & (1 << 1))) {
+            int s = (v >> 3) & 0xF;
+            uint32_t at = s < 4 ? s << 14 : s == 4 ? 0x10000 : (s - 4) << 17;
+            uint32_t size = s < 4 ? 0x4000 : s == 4 ? 0x10000 : 0x20000;
+            if (flash == 0 || at + size > flashSize)
+                fatal("flash sector", s);
+            memset(flash + at, 0xFF, size);
+            word(Flash::cr) = v & ~(1 << 16); // STRT
+        }
+    }
+
+    template< int N >
+    void setupTimer () {
+        tim[N].base = Timer<N>::base;
+        tim[N].r = &word(Timer<N>::base);
+        tim[N].irq = Timer<N>::irq;
+        tim[N].ccIrq = N == 1 ? 27 : N == 8 ? 46 : Timer<N>::irq;
+    }
+
+    [[noreturn]] __attribute__((cold)) static void fatal (char const* msg, uint32_t v) {
+        fprintf(stderr, "sim: %s %08x\n", msg, v);
+        exit(2);
+    }
+
+    //inlined everywhere, every modelled register access goes through here
+    __attribute__((always_inline)) uint32_t& word (uint32_t a) {
+        a &= ~3;
+        if (a - 0x40000000 < 0x80000)
+            return periph[(a - 0x40000000) >> 2];
+        if (a - 0xE0000000 < 0x100000)
+            return core[(a - 0xE0000000) >> 2];
+        fatal("unmapped register", a);
+    }
+
+    __attribute__((always_inline)) uint32_t& reg (uint32_t a) { return word(a); }
+
+    //Plant side of the gpio pins
+    void drive (char port, int pin, bool high) {
+        int k = port - 'A';
+        uint16_t was = level[k], by = driven[k];
+        driven[k] |= 1 << pin;
+        level[k] = (level[k] & ~(1 << pin)) | (high << pin);
+        pinsMoved |= level[k] != was || driven[k] != by;
+    }
+
+    void release (char port, int pin) {
+        driven[port - 'A'] &= ~(1 << pin);
+        pinsMoved = true;
+    }
+
+    bool output (char port, int pin) const {
+        return (periph[(Port<'A'>::odr - 0x40000000 + 0x400 * (port - 'A')) >> 2] >> pin) & 1;
+    }
+
+    //Average duty 0..1 of a timer channel in PWM mode 1, 0 if not driven
+    double duty (int n, int ch) {
+        TimerModel& t = tim[n];
+        settle(t, now);
+        uint32_t cr1 = t.at(0), ccer = t.at(0x20);
+        uint32_t ccmr = t.at(ch <= 2 ? 0x18 : 0x1C) >> (8 * ((ch - 1) & 1));
+        bool moe = (n != 1 && n != 8) || (t.at(0x44) & (1 << 15));
+        if (!(cr1 & 1) || !(ccer & (1 << 4 * (ch - 1))) || !moe)
+            return 0;
+        uint32_t arr = t.at(0x2C), top = centered(t) ? arr : arr + 1;
+        switch ((ccmr >> 4) & 7) {
+            case 0b100: return 0;
+            case 0b101: return 1;
+            case 0b110: return t.ccr[ch-1] >= top ? 1 : (double) t.ccr[ch-1] / top;
+            case 0b111: return t.ccr[ch-1] >= top ? 0 : 1 - (double) t.ccr[ch-1] / top;
+        }
+        return 0;
+    }
+
+    //Level of a timer channel's output now, see reference(). Low if not
+    //enabled
+    bool compareOutput (int n, int ch) {
+        TimerModel& t = tim[n];
+        settle(t, now);
+        uint32_t ccer = t.at(0x20);
+        bool moe = (n != 1 && n != 8) || (t.at(0x44) & (1 << 15));
+        if (!(ccer & (1 << 4 * (ch - 1))) || !moe)
+            return false;
+        return reference(t, ch, ocm(t, ch), now);
+    }
+
+    //Timers
+
+    //center-aligned mode: 0 edge-aligned, else the compare directions
+    int centered (TimerModel& t) { return (t.at(0) >> 5) & 3; }
+    uint64_t unit (TimerModel& t) { return (uint64_t) t.tick * (t.psc + 1); }
+
+    //one up (and down) cycle of the counter, and the time between updates
+    uint64_t period (TimerModel& t) {
+        uint32_t arr = t.at(0x2C);
+        return (centered(t) ? 2 * (uint64_t) arr : arr + 1) * unit(t);
+    }
+    uint64_t interval (TimerModel& t) { return centered(t) ? period(t) / 2 : period(t); }
+    bool running (TimerModel& t) { return t.at(0) & 1; }
+
+    //output compare mode of channel ch
+    int ocm (TimerModel& t, int ch) {
+        return (t.at(ch <= 2 ? 0x18 : 0x1C) >> (8 * ((ch - 1) & 1) + 4)) & 7;
+    }
+
+    //OCxREF of channel ch in mode "mode": forced, PWM mode 1 and 2 against
+    //the count (edge-aligned), else as the last match or mode left it
+    bool reference (TimerModel& t, int ch, int mode, uint64_t at) {
+        switch (mode) {
+            case 0b100: return false;
+            case 0b101: return true;
+            case 0b110: return count(t, at) < t.ccr[ch-1];
+            case 0b111: return count(t, at) >= t.ccr[ch-1];
+        }
+        return t.ref[ch-1];
+    }
+
+    uint32_t count (TimerModel& t, uint64_t at) {
+        if (!running(t))
+            return t.at(0x24);
+        uint64_t rel = at > t.origin ? at - t.origin : 0;
+        uint32_t c = rel % period(t) / unit(t), arr = t.at(0x2C);
+        return centered(t) && c > arr ? 2 * arr - c : c;
+    }
+
+    //times within a cycle at which channel ch matches and flags, 0..2 of them
+    int matches (TimerModel& t, int ch, uint64_t at [2]) {
+        uint64_t ccr = t.ccr[ch-1], arr = t.at(0x2C);
+        int cms = centered(t), n = 0;
+        if (!cms)
+            at[n++] = ccr * unit(t);
+        else if (ccr <= arr) {
+            if (cms & 2)
+                at[n++] = ccr * unit(t);
+            if ((cms & 1) && ccr > 0)
+                at[n++] = (2 * arr - ccr) * unit(t);
+        }
+        return n;
+    }
+
+    void rebase (TimerModel& t, uint32_t cnt, uint64_t at) {
+        t.origin = at - (uint64_t) cnt * unit(t);
+        t.seen = 0;
+    }
+
+    void load (TimerModel& t) {
+        for (int i = 0; i < 4; ++i)
+            if (t.preload[i]) {
+                t.ccr[i] = t.at(0x34 + 4 * i);
+                t.preload[i] = false;
+                if ((t.compares >> (i + 1)) & 1)
+                    t.replan = true;
+            }
+        t.loadAt = never;
+    }
+
+    void reload (TimerModel& t) {
+        uint32_t psc = t.at(0x28) & 0xFFFF;
+        if (psc != t.psc)
+            t.replan = true;
+        t.psc = psc;
+        load(t);
+    }
+
+    //A preloaded ccr no compare event depends on (a PWM duty) is loaded
+    //when the shadow value is next looked at, not by an update event:
+    //those came twice per PWM cycle and were most of the events run.
+    //With a repetition counter updates are still handled as events
+    void settle (TimerModel& t, uint64_t at) {
+        if (at >= t.loadAt)
+            load(t);
+    }
+
+    void schedule (TimerModel& t, uint64_t at) {
+        bool pending = t.preload[0] || t.preload[1] || t.preload[2] || t.preload[3];
+        t.loadAt = never;
+        if (pending && running(t) && t.at(0x30) == 0 && t.rep == 0 && at >= t.origin) {
+            uint64_t i = interval(t);
+            t.loadAt = t.origin + ((at - t.origin) / i + 1) * i;
+        }
+    }
+
+    //regular trigger source of an ADC, when external triggering is on
+    int extsel (int adc) {
+        uint32_t cr2 = reg(ADC<1>::cr2 + 0x100 * (adc - 1));
+        return (cr2 & (3 << 28)) && (cr2 & 1) ? (cr2 >> 24) & 0xF : -1;
+    }
+
+    bool triggers (int n, int ch) { return (linked[n] >> ch) & 1; }
+
+    //injected trigger source of an ADC, when injected triggering is on
+    int jextsel (int adc) {
+        uint32_t cr2 = reg(ADC<1>::cr2 + 0x100 * (adc - 1));
+        return (cr2 & (3 << 20)) && (cr2 & 1) ? (cr2 >> 16) & 0xF : -1;
+    }
+
+    //does event ch of timer n (0 = TRGO) start a conversion on ADC adc
+    bool starts (int adc, int n, int ch, bool injected) {
+        int sel = injected ? ADC<1>::injectedEvent(n, ch) : ADC<1>::timerEvent(n, ch);
+        return sel >= 0 && sel == (injected ? jextsel(adc) : extsel(adc));
+    }
+
+    //which timer events start ADC conversions, redone when an ADC changes
+    void link () {
+        for (int n = 1; n <= 14; ++n) {
+            linked[n] = 0;
+            for (int ch = 0; ch <= 4; ++ch) {
+                regularBy[n][ch] = injectedBy[n][ch] = 0;
+                for (int adc = 1; adc <= 3; ++adc) {
+                    regularBy[n][ch] |= starts(adc, n, ch, false) << adc;
+                    injectedBy[n][ch] |= starts(adc, n, ch, true) << adc;
+                }
+                if (regularBy[n][ch] | injectedBy[n][ch])
+                    linked[n] |= 1 << ch;
+            }
+        }
+    }
+
+    bool needsCompare (TimerModel& t, int ch) {
+        int mode = ocm(t, ch);
+        return (t.at(0x0C) & (1 << ch)) || triggers(t.n, ch) || (mode >= 1 && mode <= 3);
+    }
+
+    //updates need handling as events, not just as a flag seen later
+    bool needsUpdates (TimerModel& t) {
+        uint32_t cr1 = t.at(0);
+        if ((t.at(0x0C) & 1) || (cr1 & (1 << 3)) || t.at(0x30) != 0 || t.rep != 0 ||
+                (((t.at(0x04) >> 4) & 7) == 2 && triggers(t.n, 0)))
+            return true;
+        for (int ch = 1; ch <= 4; ++ch)
+            if (t.preload[ch-1] && needsCompare(t, ch))
+                return true;
+        return false;
+    }
+
+    //the events of a cycle, looked up on every event of a running timer
+    void plan (TimerModel& t) {
+        t.replan = false;
+        t.period = period(t);
+        t.interval = interval(t);
+        t.updates = needsUpdates(t);
+        t.compares = 0;
+        t.phases = 0;
+        for (int ch = 1; ch <= 4; ++ch)
+            if (needsCompare(t, ch)) {
+                t.compares |= 1 << ch;
+                uint64_t at [2];
+                for (int j = matches(t, ch, at); j-- > 0; ) {
+                    t.phase[t.phases] = at[j];
+                    t.channel[t.phases++] = ch;
+                }
+            }
+    }
+
+    //start of the planned cycle holding "at", not before the origin. Each
+    //event is at most a cycle on from the last one, so it is stepped to
+    //rather than divided out, unless the timer was restarted or retimed
+    uint64_t cycleStart (TimerModel& t, uint64_t at) {
+        uint64_t p = t.period;
+        if (at < t.origin)
+            return t.origin;
+        if (t.cycleOrigin != t.origin || t.cyclePeriod != p || at < t.cycle || at - t.cycle >= 4 * p) {
+            t.cycle = t.origin + (at - t.origin) / p * p;
+            t.cycleOrigin = t.origin;
+            t.cyclePeriod = p;
+        }
+        while (at - t.cycle >= p)
+            t.cycle += p;
+        return t.cycle;
+    }
+
+    uint64_t nextEvent (TimerModel& t) {
+        if (t.n == 0 || !running(t))
+            return never;
+        settle(t, now);
+        if (t.replan)
+            plan(t);
+        uint64_t p = t.period, next = never, start = cycleStart(t, now);
+        //updates come every cycle, or at its start and middle
+        if (t.updates)
+            next = start + (now >= start + t.interval ? 2 : 1) * t.interval;
+        for (int j = 0; j < t.phases; ++j) {
+            uint64_t at = start + t.phase[j];
+            if (at <= now)
+                at += p;
+            if (at < next)
+                next = at;
+        }
+        return next;
+    }
+
+    void timerEvents (TimerModel& t) {
+        if (!running(t) || now < t.origin)
+            return;
+        settle(t, now);
+        if (t.replan)
+            plan(t);
+        uint64_t i = t.interval, rel = now - t.origin, phase = now - cycleStart(t, now);
+        uint32_t dier = t.at(0x0C);
+        if (rel > 0 && (phase == 0 || phase == i)) {
+            if (t.rep > 0) {
+                //the last repetition, the update ending it may load lazily
+                if (--t.rep == 0) {
+                    t.replan = true;
+                    schedule(t, now);
+                }
+            } else {
+                t.rep = t.at(0x30) & 0xFF;
+                t.at(0x10) |= 1 << 0; // UIF
+                flagged |= 1 << t.n;
+                raised |= dier & 1;
+                t.seen = rel / i;
+                reload(t);
+                if (((t.at(0x04) >> 4) & 7) == 2)
+                    convertOn(t.n, 0);
+                if (t.at(0) & (1 << 3)) { // OPM
+                    t.at(0) &= ~1;
+                    t.at(0x24) = 0;
+                    return;
+                }
+            }
+        }
+        for (int j = 0; j < t.phases; ++j)
+            if (phase == t.phase[j]) {
+                int ch = t.channel[j];
+                t.at(0x10) |= 1 << ch; // CCxIF
+                flagged |= 1 << t.n;
+                raised |= (dier >> ch) & 1;
+                switch (ocm(t, ch)) {
+                    case 0b001: t.ref[ch-1] = true; break;
+                    case 0b010: t.ref[ch-1] = false; break;
+                    case 0b011: t.ref[ch-1] = !t.ref[ch-1]; break;
+                }
+                convertOn(t.n, ch);
+            }
+    }
+
+    void timerWrite (TimerModel& t, uint32_t off, uint32_t old, uint32_t v) {
+        uint64_t at = cpu;
+        //the status and count registers leave the schedule as it is
+        if (off != 0x10 && off != 0x24 && (off < 0x34 || off > 0x40))
+            t.replan = true;
+        if (off != 0x10 && (off < 0x34 || off > 0x40))
+            stale |= 1 << t.n;
+        settle(t, at);
+        switch (off) {
+            case 0x00: // CR1
+                if (!(old & 1) && (v & 1))
+                    rebase(t, t.at(0x24), at);
+                else if ((old & 1) && !(v & 1))
+                    t.at(0x24) = count(t, at);
+                break;
+            case 0x0C: // DIER
+                armed = (armed & ~(1 << t.n)) | ((v & 0x1F) != 0) << t.n;
+                break;
+            case 0x10: // SR, rc_w0
+                t.at(0x10) = old & v;
+                break;
+            case 0x14: // EGR
+                if (v & 1) {
+                    t.rep = t.at(0x30) & 0xFF;
+                    reload(t);
+                    for (int i = 0; i < 4; ++i)
+                        t.ccr[i] = t.at(0x34 + 4 * i);
+                    t.at(0x24) = 0;
+                    rebase(t, 0, at);
+                    t.at(0x10) |= 1; // UIF
+                    flagged |= 1 << t.n;
+                }
+                t.at(0x14) = 0;
+                break;
+            case 0x18: case 0x1C: // CCMR1, CCMR2
+                //a new mode starts from the reference the old one left
+                for (int i = 0; i < 2; ++i) {
+                    int ch = (off - 0x18) / 2 + i + 1, shift = 8 * i + 4;
+                    if (((old ^ v) >> shift) & 7)
+                        t.ref[ch-1] = reference(t, ch, (old >> shift) & 7, at);
+                }
+                break;
+            case 0x24: // CNT
+                rebase(t, v, at);
+                break;
+            case 0x2C: { // ARR, without preload
+                uint32_t cnt = count(t, at);
+                rebase(t, cnt > v ? 0 : cnt, at);
+                break;
+            }
+            case 0x34: case 0x38: case 0x3C: case 0x40: { // CCR1..4
+                int i = (off - 0x34) / 4;
+                uint32_t ccmr = t.at(i < 2 ? 0x18 : 0x1C) >> (8 * (i & 1));
+                if ((ccmr & (1 << 3)) && running(t))
+                    t.preload[i] = true;
+                else
+                    t.ccr[i] = v;
+                //only compare events someone waits for are scheduled
+                if (needsCompare(t, i + 1)) {
+                    t.replan = true;
+                    stale |= 1 << t.n;
+                }
+                break;
+            }
+        }
+        schedule(t, at);
+    }
+
+    uint32_t timerRead (TimerModel& t, uint32_t off, uint32_t v) {
+        switch (off) {
+            case 0x10: // SR, updates that were not handled as events
+                if (running(t)) {
+                    uint64_t periods = cpu > t.origin ? (cpu - t.origin) / interval(t) : 0;
+                    if (periods > t.seen) {
+                        t.seen = periods;
+                        v = t.at(0x10) |= 1;
+                        flagged |= 1 << t.n;
+                    }
+                }
+                return v;
+            case 0x24: // CNT
+                return count(t, cpu);
+        }
+        return v;
+    }
+
+    //ADC
+
+    static uint32_t adcBase (int adc) { return ADC<1>::base + 0x100 * (adc - 1); }
+
+    //channel at position i of the regular sequence, SQ1..SQ16
+    int sequence (int adc, int i) {
+        uint32_t sqr = adcBase(adc) + 0x34 - 4 * (i / 6);
+        return (reg(sqr) >> 5 * (i % 6)) & 0x1F;
+    }
+
+    //core cycles per ADC clock: APB2 at 84 MHz, divided by 2, 4, 6 or 8
+    int adcClock () { return 4 * (((reg(ADC<1>::ccr) >> 16) & 3) + 1); }
+
+    //cycles from start to end of conversion of a channel
+    int conversion (int adc, int chan) {
+        static const int sampleCycles [] = { 3, 15, 28, 56, 84, 112, 144, 480 };
+        uint32_t smpr = reg(adcBase(adc) + (chan < 10 ? 0x10 : 0x0C));
+        return adcClock() * (sampleCycles[(smpr >> 3 * (chan < 10 ? chan : chan - 10)) & 7] + 12);
+    }
+
+    void convert (int adc, int chan) {
+        uint32_t base = adcBase(adc);
+        reg(base + 0x4C) = analog != 0 ? analog(adc, chan) & 0xFFF : 0;
+        reg(base) |= 1 << 1; // EOC
+        raised |= (reg(base + 0x04) >> 5) & 1; // EOCIE
+        if (reg(base + 0x08) & (1 << 8)) // DMA
+            dmaRequest(base + 0x4C, reg(base + 0x4C));
+    }
+
+    //scan mode converts the whole sequence, one channel after the other
+    bool scanning (int adc) { return reg(adcBase(adc) + 0x04) & (1 << 8); }
+
+    //the sequences, worked out again after the code writes to the ADC,
+    //see adcWrite()
+    void refresh (int adc) {
+        Sequence& r = adcRegular[adc];
+        r.length = scanning(adc) ? (reg(adcBase(adc) + 0x2C) >> 20 & 0xF) + 1 : 1;
+        //the whole of SQ1..16 when scanning, else up to where a scan cut short is
+        int n = scanning(adc) || interleaved() ? 16 : adcSeq[adc] + 1;
+        for (int i = 0; i < n; ++i) {
+            r.chan[i] = sequence(adc, i);
+            r.cycles[i] = conversion(adc, r.chan[i]);
+        }
+        Sequence& j = adcInjected[adc];
+        j.length = injectedLength(adc);
+        j.total = 0;
+        for (int i = 0; i < j.length; ++i) {
+            j.chan[i] = injected(adc, i);
+            j.cycles[i] = conversion(adc, j.chan[i]);
+            j.total += j.cycles[i];
+        }
+        adcFresh |= 1 << adc;
+    }
+
+    Sequence& regular (int adc) {
+        if (!((adcFresh >> adc) & 1))
+            refresh(adc);
+        return adcRegular[adc];
+    }
+
+    Sequence& injectedSequence (int adc) {
+        if (!((adcFresh >> adc) & 1))
+            refresh(adc);
+        return adcInjected[adc];
+    }
+
+    void convert (int adc) { convert(adc, regular(adc).chan[0]); }
+
+    void startSequence (int adc, uint64_t at) {
+        adcSeq[adc] = 0;
+        adcDue[adc] = at + regular(adc).cycles[0];
+    }
+
+    //multi-ADC mode: triple interleaved, paced by ADC1 (the master) alone
+    bool interleaved () { return (reg(ADC<1>::ccr) & 0x1F) == 0b10111; }
+    int interleaveStep () { return adcClock() * (((reg(ADC<1>::ccr) >> 8) & 0xF) + 5); }
+
+    //ADC1, 2, 3 take turns, every second sample completes a word in cdr
+    void interleaveEvent () {
+        int adc = 1 + adcSeq[1] % 3;
+        uint16_t v = analog != 0 ? analog(adc, sequence(adc, 0)) & 0xFFF : 0;
+        if (adcSeq[1] & 1) {
+            reg(ADC<1>::cdr) = (uint32_t) v << 16 | pairLow;
+            dmaRequest(ADC<1>::cdr, reg(ADC<1>::cdr));
+        } else
+            pairLow = v;
+        adcSeq[1] = (adcSeq[1] + 1) % 6;
+        if (reg(ADC<1>::cr2) & (1 << 1)) // CONT
+            adcDue[1] += interleaveStep();
+        else
+            adcDue[1] = never;
+    }
+
+    //end of a conversion in a sequence, or continuous conversions
+    void adcEvent (int adc) {
+        if (adc == 1 && interleaved())
+            return interleaveEvent();
+        Sequence& s = regular(adc);
+        convert(adc, s.chan[adcSeq[adc]]);
+        if (++adcSeq[adc] >= s.length) {
+            adcSeq[adc] = 0;
+            if (!(reg(adcBase(adc) + 0x08) & (1 << 1))) { // CONT
+                adcDue[adc] = never;
+                return;
+            }
+        }
+        adcDue[adc] += s.cycles[adcSeq[adc]];
+    }
+
+    //injected sequence of JL + 1 channels, JSQ4 is always the last one
+    int injectedLength (int adc) { return ((reg(adcBase(adc) + 0x38) >> 20) & 3) + 1; }
+    int injected (int adc, int i) {
+        return (reg(adcBase(adc) + 0x38) >> 5 * (4 - injectedLength(adc) + i)) & 0x1F;
+    }
+
+    //an injected trigger aborts the regular conversion under way, which
+    //starts over once the injected sequence is done. Triggers while an
+    //injected sequence runs are ignored
+    void startInjected (int adc) {
+        if (injectDue[adc] != never)
+            return;
+        uint64_t at = now + injectedSequence(adc).total;
+        injectDue[adc] = at;
+        if (adcDue[adc] != never)
+            adcDue[adc] = at + regular(adc).cycles[adcSeq[adc]];
+    }
+
+    void injectEvent (int adc) {
+        uint32_t base = adcBase(adc);
+        Sequence& s = injectedSequence(adc);
+        injectDue[adc] = never;
+        for (int i = 0; i < s.length; ++i)
+            reg(base + 0x3C + 4 * i) = analog != 0 ? analog(adc, s.chan[i]) & 0xFFF : 0;
+        reg(base) |= 1 << 2; // JEOC
+        raised |= (reg(base + 0x04) >> 7) & 1; // JEOCIE
+    }
+
+    //event ch of timer n happened, 0 = TRGO
+    void convertOn (int n, int ch) {
+        if (!triggers(n, ch))
+            return;
+        for (int adc = 1; adc <= 3; ++adc) {
+            if ((injectedBy[n][ch] >> adc) & 1)
+                startInjected(adc);
+            if (!((regularBy[n][ch] >> adc) & 1))
+                continue;
+            if (scanning(adc))
+                startSequence(adc, now);
+            else
+                convert(adc);
+        }
+    }
+
+    //DMA
+
+    static uint32_t dmaStream (int k) { return (k < 8 ? 0x40026010 : 0x40026410) + 0x18 * (k & 7); }
+
+    static int dmaIrq (int k) {
+        int s = k & 7;
+        return k < 8 ? (s < 7 ? 11 + s : 47) : (s < 5 ? 56 + s : 63 + s);
+    }
+
+    //flags of stream k in its isr: where they are and the register
+    static int dmaShift (int k) { return 6 * (k & 1) + 16 * ((k >> 1) & 1); }
+    static uint32_t dmaIsr (int k) { return (k < 8 ? 0x40026000 : 0x40026400) + ((k & 7) < 4 ? 0 : 4); }
+
+    //a peripheral has data at "from", for whichever stream is set up to take it
+    void dmaRequest (uint32_t from, uint32_t v) {
+        for (uint32_t m = dmaOn; m != 0; m &= m - 1) {
+            int k = __builtin_ctz(m);
+            uint32_t* s = &word(dmaStream(k)); // CR, NDTR, PAR, M0AR, M1AR
+            if (s[2] != from || (s[0] & (3 << 6)))
+                continue;
+            uint32_t c = s[0], count = dmaCount[k], left = s[1];
+            int size = 1 << ((c >> 13) & 3);
+            uint32_t at = s[(c & (1 << 19)) ? 4 : 3]; // CT: M1AR, M0AR
+            if (c & (1 << 10)) // MINC
+                at += (count - left) * size;
+            void* p = (void*) (uintptr_t) at;
+            if (size == 1)
+                *(uint8_t*) p = v;
+            else if (size == 2)
+                *(uint16_t*) p = v;
+            else
+                *(uint32_t*) p = v;
+            uint32_t flags = 0;
+            if (--left == count / 2)
+                flags |= 1 << 4; // HTIF
+            if (left == 0) {
+                flags |= 1 << 5; // TCIF
+                if (c & (3 << 18 | 1 << 8)) { // DBM or CIRC
+                    left = count;
+                    if (c & (1 << 18))
+                        s[0] = c ^ (1 << 19);
+                } else {
+                    s[0] = c & ~1;
+                    dmaOn &= ~(1 << k);
+                }
+            }
+            s[1] = left;
+            if (flags) {
+                reg(dmaIsr(k)) |= flags << dmaShift(k);
+                raised |= (dmaArmed >> k) & 1;
+            }
+            return;
+        }
+    }
+
+    void dmaWrite (uint32_t w, uint32_t old, uint32_t v) {
+        int k = (w >= 0x40026400 ? 8 : 0), off = w & 0x3FF;
+        if (off == 0x08 || off == 0x0C) { // LIFCR, HIFCR: clear flags
+            word(w - 8) &= ~v;
+            word(w) = 0;
+            return;
+        }
+        if (off < 0x10 || (off - 0x10) % 0x18 != 0)
+            return;
+        k += (off - 0x10) / 0x18;
+        if (!(old & 1) && (v & 1))
+            dmaCount[k] = reg(w + 0x04);
+        dmaOn = (dmaOn & ~(1 << k)) | (v & 1) << k;
+        bool irqs = (v & 1) && (v & (3 << 3)); // HTIE, TCIE
+        dmaArmed = (dmaArmed & ~(1 << k)) | (uint32_t) irqs << k;
+    }
+
+    void adcWrite (int adc, uint32_t off, uint32_t old, uint32_t v) {
+        uint32_t base = adcBase(adc);
+        if (adc > 3 || off == 0x04 || off == 0x0C || off == 0x10 || (off >= 0x2C && off <= 0x38))
+            adcFresh &= adc > 3 ? 0 : ~(1U << adc); // CCR, CR1, SMPR, SQR, JSQR: see refresh()
+        if (adc > 3) { // common registers, MULTI in ccr
+            if (off == 0x04 && (old & 0x1F) && !(v & 0x1F))
+                adcDue[1] = never;
+            return;
+        }
+        if (off == 0x04) // CR1, EOCIE, JEOCIE
+            adcArmed = (adcArmed & ~(1 << (adc - 1))) | (uint32_t) ((v & 0xA0) != 0) << (adc - 1);
+        if (off == 0x08 && ((old ^ v) & 0x3F3F0001)) { // EXTEN, EXTSEL, JEXTEN, JEXTSEL, ADON
+            link();
+            for (int n = 1; n <= 14; ++n)
+                tim[n].replan = true;
+            stale = ~0U;
+        }
+        if (off == 0x08 && !(v & 1))
+            adcDue[adc] = injectDue[adc] = never;
+        if (off == 0x00) // SR, rc_w0
+            reg(base) = old & v;
+        else if (off == 0x08 && (v & (1 << 30))) { // SWSTART
+            reg(base + 0x08) &= ~(1 << 30);
+            if ((v & 1) && adc == 1 && interleaved()) {
+                adcSeq[1] = 0;
+                adcDue[1] = cpu + interleaveStep();
+            } else if ((v & 1) && (scanning(adc) || (v & (1 << 1)))) // SCAN, CONT
+                startSequence(adc, cpu);
+            else if (v & 1) {
+                cpu += regular(adc).cycles[0];
+                convert(adc);
+            }
+        }
+    }
+
+    //GPIO and EXTI
+
+    //pins whose 2-bit field in a mode register equals 01
+    static uint32_t fieldsOne (uint32_t x) {
+        x = x & ~(x >> 1) & 0x55555555;
+        x = (x | (x >> 1)) & 0x33333333;
+        x = (x | (x >> 2)) & 0x0F0F0F0F;
+        x = (x | (x >> 4)) & 0x00FF00FF;
+        return (x | (x >> 8)) & 0xFFFF;
+    }
+
+    uint32_t inputs (int k) {
+        uint32_t base = Port<'A'>::base + 0x400 * k;
+        uint32_t out = fieldsOne(reg(base)), up = fieldsOne(reg(base + 0x0C));
+        uint32_t in = (level[k] & driven[k]) | (up & ~driven[k]);
+        return (reg(base + 0x14) & out) | (in & ~out);
+    }
+
+    //edges on the EXTI lines since the last call, none unless a pin moved
+    void sampleExti () {
+        if (!pinsMoved)
+            return;
+        pinsMoved = false;
+        uint32_t imr = reg(Exti<PinA<0>>::imr);
+        if (imr == 0)
+            return;
+        uint16_t now = 0;
+        for (uint32_t m = imr & 0xFFFF; m != 0; m &= m - 1) {
+            int line = __builtin_ctz(m);
+            int k = (reg(Exti<PinA<0>>::exticr1 + 4 * (line >> 2)) >> 4 * (line & 3)) & 0xF;
+            now |= ((inputs(k) >> line) & 1) << line;
+        }
+        uint16_t rose = now & ~extiLast, fell = ~now & extiLast;
+        if (rose | fell) {
+            reg(Exti<PinA<0>>::pr) |= imr & ((rose & reg(Exti<PinA<0>>::rtsr)) |
+                                             (fell & reg(Exti<PinA<0>>::ftsr)));
+            raised = true;
+        }
+        extiLast = now;
+    }
+
+    //Interrupts
+
+    //interrupt lines raised by the peripherals, one bit per irq
+    void asserted (uint64_t lines [2]) {
+        lines[0] = lines[1] = 0;
+        for (uint32_t m = armed & flagged; m != 0; m &= m - 1) {
+            TimerModel& t = tim[__builtin_ctz(m)];
+            uint32_t sr = t.at(0x10), due = sr & t.at(0x0C) & 0x1F;
+            if (!(sr & 0x1F))
+                flagged &= ~(1 << t.n);
+            if (due & 1)
+                lines[t.irq >> 6] |= 1ULL << (t.irq & 63);
+            if (due & 0x1E)
+                lines[t.ccIrq >> 6] |= 1ULL << (t.ccIrq & 63);
+        }
+        for (uint32_t m = adcArmed; m != 0; m &= m - 1) {
+            uint32_t base = ADC<1>::base + 0x100 * __builtin_ctz(m);
+            uint32_t sr = reg(base), cr1 = reg(base + 0x04);
+            if (((sr & (1 << 1)) && (cr1 & (1 << 5))) || ((sr & (1 << 2)) && (cr1 & (1 << 7))))
+                lines[0] |= 1ULL << 18; // EOC, JEOC
+        }
+        for (uint32_t m = dmaArmed; m != 0; m &= m - 1) {
+            int k = __builtin_ctz(m);
+            //HTIF, TCIF sit one bit above HTIE, TCIE
+            uint32_t due = reg(dmaIsr(k)) >> (dmaShift(k) + 1) & reg(dmaStream(k)) & (3 << 3);
+            if (due)
+                lines[dmaIrq(k) >> 6] |= 1ULL << (dmaIrq(k) & 63);
+        }
+        uint32_t pr = reg(Exti<PinA<0>>::pr);
+        if (pr == 0)
+            return;
+        pr &= reg(Exti<PinA<0>>::imr);
+        lines[0] |= (uint64_t) (pr & 0x1F) << 6;
+        if (pr & 0x03E0)
+            lines[0] |= 1ULL << 23;
+        if (pr & 0xFC00)
+            lines[0] |= 1ULL << 40;
+    }
+
+    bool enabled (int irq) { return (reg(0xE000E100 + 4 * (irq >> 5)) >> (irq & 0x1F)) & 1; }
+    int priority (int irq) { return (reg(0xE000E400 + (irq & ~3)) >> 8 * (irq & 3)) & 0xFF; }
+
+    //Run due handlers, most urgent first, until none is left
+    //Only needed after a peripheral raised a flag or the code wrote
+    void dispatch () {
+        if (!raised)
+            return;
+        if (cpu < now)
+            cpu = now;
+        for (int runs = 0; ; ++runs) {
+            uint64_t lines [2];
+            asserted(lines);
+            int best = -1;
+            for (int i = 0; i < 2; ++i)
+                for (uint64_t m = lines[i]; m != 0; m &= m - 1) {
+                    int irq = 64 * i + __builtin_ctzll(m);
+                    if (enabled(irq) && (best < 0 || priority(irq) < priority(best)))
+                        best = irq;
+                }
+            if (best < 0) {
+                raised = false;
+                return;
+            }
+            if (runs > 1000)
+                fatal("interrupt storm, irq", best);
+            VTable::Handler h = ((VTable::Handler*) &vtable)[16 + best];
+            if (h == 0)
+                fatal("no handler for irq", best);
+            cpu += 12; // exception entry
+            h();
+        }
+    }
+
+    //Advance to time "until", calling step(dt in cycles) for the plant
+    //every "stepCycles" and running interrupts as they come due
+    template< typename F >
+    void run (uint64_t until, uint32_t stepCycles, F step) {
+        uint64_t plant = now - now % stepCycles + stepCycles, conversions = never;
+        //the ADCs' next event is looked for again only after something
+        //that can move it: their own events, a timer's, or code that ran
+        bool adcMoved = true;
+        while (now < until) {
+            if (stale != 0) {
+                //only if the soonest event itself moved are all looked at again
+                bool lost = false;
+                for (; stale != 0; stale &= stale - 1) {
+                    int n = __builtin_ctz(stale);
+                    if (n < 1 || n > 14)
+                        continue;
+                    lost |= due[n] == soonest;
+                    due[n] = nextEvent(tim[n]);
+                    soonest = due[n] < soonest ? due[n] : soonest;
+                    timing = due[n] != never ? timing | 1 << n : timing & ~(1U << n);
+                }
+                if (lost) {
+                    soonest = never;
+                    for (uint32_t m = timing; m != 0; m &= m - 1)
+                        soonest = due[__builtin_ctz(m)] < soonest ? due[__builtin_ctz(m)] : soonest;
+                }
+            }
+            if (adcMoved) {
+                conversions = never;
+                for (int adc = 1; adc <= 3; ++adc) {
+                    conversions = adcDue[adc] < conversions ? adcDue[adc] : conversions;
+                    conversions = injectDue[adc] < conversions ? injectDue[adc] : conversions;
+                }
+                adcMoved = false;
+            }
+            uint64_t next = plant < until ? plant : until;
+            next = soonest < next ? soonest : next;
+            next = conversions < next ? conversions : next;
+            now = next;
+            if (soonest == now) {
+                for (uint32_t m = timing; m != 0; m &= m - 1) {
+                    int n = __builtin_ctz(m);
+                    if (due[n] == now) {
+                        timerEvents(tim[n]);
+                        stale |= 1 << n;
+                    }
+                }
+                adcMoved = true;
+            }
+            if (conversions == now) {
+                for (int adc = 1; adc <= 3; ++adc) {
+                    if (injectDue[adc] == now)
+                        injectEvent(adc);
+                    if (adcDue[adc] == now)
+                        adcEvent(adc);
+                }
+                adcMoved = true;
+            }
+            if (now == plant) {
+                step(stepCycles);
+                sampleExti();
+                plant += stepCycles;
+            }
+            adcMoved |= raised;
+            dispatch();
+        }
+    }
+
+    //Register access, inlined into every access of the firmware: the
+    //addresses are constants there, so most of the decoding folds away
+
+    __attribute__((always_inline)) uint32_t read (uint32_t a, int size) {
+        cpu += accessCost;
+        if (a - flashBase < flashSize && flash != 0) {
+            uint32_t v = 0;
+            memcpy(&v, flash + (a - flashBase), size);
+            return v;
+        }
+        if (a - 0x42000000 < 0x2000000) { // bit-band alias, a word access of its own
+            uint32_t off = a - 0x42000000, byte = off >> 5;
+            int bit = ((byte & 3) << 3) + ((off >> 2) & 7);
+            cpu += accessCost;
+            return (load(0x40000000 + (byte & ~3)) >> bit) & 1;
+        }
+        uint32_t v = load(a);
+        return size == 4 ? v : (v >> 8 * (a & 3)) & ((1U << 8 * size) - 1);
+    }
+
+    //the word at "a" as the code reads it
+    __attribute__((always_inline)) uint32_t load (uint32_t a) {
+        uint32_t v = word(a);
+        uint32_t w = a & ~3;
+        if (w - 0x40020000 < 0x2C00 && (w & 0x3FF) == 0x10) // IDR
+            v = inputs((w - 0x40020000) >> 10);
+        else if (w - 0x40000000 < 0x15000) {
+            int t = timerAt((w - 0x40000000) >> 10);
+            if (t != 0)
+                v = timerRead(tim[t], w & 0x3FF, v);
+            else if (w - 0x40012000 < 0x300 && (w & 0xFF) == 0x4C) // ADC DR
+                word(w - 0x4C) &= ~(1 << 1); // EOC, cleared by reading
+        } else if (w == DWT::cyccnt && (word(DWT::ctrl) & 1))
+            v = (uint32_t) (cpu - cycBase);
+        return v;
+    }
+
+    __attribute__((always_inline)) void write (uint32_t a, uint32_t v, int size) {
+        cpu += accessCost;
+        raised = true;
+        if (a - 0x42000000 < 0x2000000) { // bit-band alias, a word access of its own
+            uint32_t off = a - 0x42000000, byte = off >> 5;
+            int bit = ((byte & 3) << 3) + ((off >> 2) & 7);
+            uint32_t w = 0x40000000 + (byte & ~3), old = word(w);
+            cpu += accessCost;
+            store(w, old, (v & 1) ? old | (1U << bit) : old & ~(1U << bit));
+            return;
+        }
+        if (a - flashBase < flashSize)
+            return flashWrite(a, v, size);
+        uint32_t w = a & ~3, old = word(w);
+        if (size < 4) {
+            int shift = 8 * (a & 3);
+            uint32_t mask = ((1U << 8 * size) - 1) << shift;
+            v = (old & ~mask) | ((v << shift) & mask);
+        }
+        store(w, old, v);
+    }
+
+    //word w changes from "old" to v, and what the peripheral makes of it
+    __attribute__((always_inline)) void store (uint32_t w, uint32_t old, uint32_t v) {
+        word(w) = v;
+        if (w - 0x40020000 < 0x2C00 && (w & 0x3FF) == 0x18) { // BSRR
+            uint32_t& odr = word(w - 0x04);
+            uint32_t was = odr;
+            odr = (odr & ~(v >> 16)) | (v & 0xFFFF);
+            word(w) = 0;
+            pinsMoved |= odr != was;
+        } else if (w - 0x40020000 < 0x2C00)
+            pinsMoved |= v != old;
+        else if (w - 0x40000000 < 0x15000) {
+            if (w - 0x40013800 < 0x800) // SYSCFG and EXTI
+                pinsMoved |= v != old;
+            int t = timerAt((w - 0x40000000) >> 10);
+            if (t != 0)
+                timerWrite(tim[t], w & 0x3FF, old, v);
+            else if (w - 0x40012000 < 0x300)
+                adcWrite(((w - 0x40012000) >> 8) + 1, w & 0xFF, old, v);
+            else if (w == Exti<PinA<0>>::pr) // rc_w1
+                word(w) = old & ~v;
+            else if (w == Flash::cr)
+                flashControl(v);
+        } else if (w - 0x40026000 < 0x800)
+            dmaWrite(w, old, v);
+        else if (w - 0xE000E100 < 0x20) // ISER, write 1 to set
+            word(w) = old | v;
+        else if (w - 0xE000E180 < 0x20) { // ICER
+            word(w - 0x80) &= ~v;
+            word(w) = 0;
+        } else if (w == DWT::cyccnt)
+            cycBase = cpu - v;
+    }
+};
+
+__attribute__((always_inline)) inline Machine& machine () {
+    static Machine m;
+    return m;
+}
+
+__attribute__((always_inline)) inline uint32_t read (uint32_t addr, int size) {
+    return machine().read(addr, size);
+}
+
+__attribute__((always_inline)) inline void write (uint32_t addr, uint32_t v, int size) {
+    machine().write(addr, v, size);
+}
+
+inline double seconds () { return (double) machine().now / cpuHz; }
+
+} //namespace Sim
+
+//The vector table handlers are installed in
+inline VTable& VTableRam () { return Sim::machine().vtable; }
+
+#endif //HOST_SIM
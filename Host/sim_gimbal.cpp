@@ -0,0 +1,387 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+//Closed-loop gimbal simulation: the firmware's actuator drives, fixed
+//rate loop, valve bank and dead-time estimator run unmodified on the
+//simulated registers of sim.h, against the plant models of plant.h
+//With "tune", the position loops are first relay auto-tuned at rest and
+//the gains kept in simulated flash, read back as at the next start-up,
+//with "kalman" the drives estimate velocity with a Kalman filter, with
+//"mpc" the position loops are explicit MPC on a table built at start-up,
+//with "jam" actuator a seizes half-way through and has to be caught by
+//the stall detectors, which watch both drives in every run, with "scan"
+//ADC1 converts both positions continuously into DMA frames, in between
+//the injected current samples of actuator a, with "capture" the drives
+//are idled at the end and a duty step on actuator a is recorded by the
+//interleaved ADCs, dumped over a console and checked, with "schedule"
+//the position gains follow a throttle swept up and down
+//usage: sim_gimbal [seconds [seed [tune] [kalman] [mpc] [jam] [scan] [capture] [schedule]]]
+
+#include <chrono>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "mpcgen.h"
+#include "sim.h"
+#include "plant.h"
+
+#include "Actuator Program/actuator.h"
+#include "Actuator Program/capture.h"
+#include "Actuator Program/deadtime.h"
+#include "Actuator Program/gainstore.h"
+#include "Actuator Program/loop.h"
+#include "Actuator Program/pins.h"
+#include "Actuator Program/valvebank.h"
+#include "Control/allocation.h"
+#include "Control/trajectory.h"
+
+//Board: actuator a on TIM1/ADC1, actuator b on TIM8/ADC3, each current
+//sampled on CC4 of its PWM timer, both positions on ADC1 as regular
+//conversions, one solenoid valve on PA5 with its position switch on PB0
+struct AxisA {
+    enum { pwmTimer = 1, pwmChannel = 1, trigChannel = 4,
+           currentAdc = 1, currentChan = 10, positionAdc = 1, positionChan = 11,
+           velocityTimer = 3, velocityHz = 2000, positionTimer = 4, positionHz = 500,
+           currentZero = 2048 };
+    typedef PinA<8> drive;
+    typedef PinB<1> dir;
+    constexpr static float ampsPerCount = 20.0f / 2048, metresPerCount = 10e-6f;
+};
+
+struct AxisB : AxisA {
+    enum { pwmTimer = 8, pwmChannel = 2,
+           currentAdc = 3, currentChan = 12, positionChan = 13,
+           velocityTimer = 5, positionTimer = 12 };
+    typedef PinC<7> drive;
+    typedef PinB<2> dir;
+};
+
+typedef ActuatorDrive<AxisA> DriveA;
+typedef ActuatorDrive<AxisB> DriveB;
+typedef ControlLoop<2,1000> Loop;
+typedef ValveBank<EcuPin<'A',5>> Valves;
+typedef PinB<0> ValveFeedback;
+typedef TransientCapture<8192> Capture;
+//Tuned gains in sector 11 of a 1 MB part
+typedef GainStore<0x080E0000, 0x20000> Store;
+
+//Console for the capture dump, the bytes are kept to be checked
+struct Console {
+    static std::vector<uint8_t> out;
+    static void putc (int c) { out.push_back(c); }
+};
+std::vector<uint8_t> Console::out;
+
+constexpr uint32_t PWM_HZ = 20000;
+constexpr double POSITION_ZERO = 2048 * AxisA::metresPerCount;
+//Estimator model: about 1.7 m/s^2 of rod acceleration per A (94 N/A on
+//55 kg reflected), 2 m/s^2 left to load and friction
+constexpr float KALMAN_PER_AMP = 1.7f, KALMAN_ACCEL = 2;
+//Stall detection: 10 ms to latch, pushing means 4 A on average, progress
+//is judged once 0.2 mm of travel has been asked for
+constexpr float STALL_MS = 10, STALL_AMPS = 4, STALL_TRAVEL = 0.2e-3f;
+//Position gain over throttle: 180 at idle, the hand-set 250 at half and
+//300 at full, the throttle sweeps 0..full..0 in 4 s
+constexpr GainTable<Cascade::SchedulePoints> throttleGains { 300, 0, 0, 3, {
+    {     0, 39322, 0, 0 },
+    { 32768, 54613, 0, 0 },
+    { 65535, 65535, 0, 0 } } };
+static_assert(throttleGains.valid(), "breakpoints must rise");
+constexpr int THROTTLE_MS = 4000;
+
+static DeadTime<Valves::count> deadTime;
+static GimbalTrajectory trajectory;
+static Allocator<> allocator;
+static GimbalAngles wanted;
+static uint32_t command, applied, start;
+static float kpLow = 1e9f, kpHigh = 0;
+
+//Application: gimbal sweep with a pitch step every second, smoothed by
+//the trajectory generator and kept within reach by the allocator, and a
+//valve toggling every 40 ms. All after holding still while the drives
+//auto-tune
+static void compute () {
+    if (DriveA::cascade.relay.running() || DriveB::cascade.relay.running()) {
+        start = Loop::ticks + 1;
+        return;
+    }
+    double t = (double) (Loop::ticks - start) / 1000;
+    GimbalAngles g;
+    g.pitch = 0.07f * sinf(2 * M_PI * 0.5 * t) + ((int) t & 1 ? 0.03f : -0.03f);
+    g.yaw = 0.06f * sinf(2 * M_PI * 1.3 * t);
+    wanted = allocator.update(trajectory.update(g));
+    command = (Loop::ticks / 40) & 1;
+    int phase = (Loop::ticks - start) % THROTTLE_MS;
+    uint16_t throttle = 65535 * (phase < THROTTLE_MS / 2 ? phase : THROTTLE_MS - phase) / (THROTTLE_MS / 2);
+    DriveA::cascade.operating.write(throttle);
+    DriveB::cascade.operating.write(throttle);
+    if (DriveA::cascade.scheduled && Loop::ticks - start >= 500) {
+        kpLow = fminf(kpLow, DriveA::cascade.gains.kp);
+        kpHigh = fmaxf(kpHigh, DriveA::cascade.gains.kp);
+    }
+}
+
+static void actuate () {
+    ActuatorLengths l = Kinematics<>::lookup(wanted);
+    DriveA::moveTo(l.a - BellGimbal::length + POSITION_ZERO);
+    DriveB::moveTo(l.b - BellGimbal::length + POSITION_ZERO);
+    Valves::write(command);
+    deadTime.commandMask(applied, command);
+    applied = command;
+}
+
+//Per sample gains: duty per A, A per m/s, m/s per m
+static void gains (Cascade& c) {
+    c.current.init(0.05f, 0.006f, 0, 1, -0.95f, 0.95f, 1);
+    c.velocity.init(60, 1, 0, 1, -15, 15, 2);
+    c.position.init(250, 0, 0, 1, -0.2f, 0.2f, 1);
+}
+
+static GimbalPlant plant;
+static Noise rng;
+static const Sensor current { AxisA::ampsPerCount, AxisA::currentZero, 1.5 };
+static const Sensor position { AxisA::metresPerCount, 2048, 0.7 };
+
+static uint16_t analog (int, int chan) {
+    switch (chan) {
+        case AxisA::currentChan:  return current.read(plant.a.amps, rng);
+        case AxisB::currentChan:  return current.read(plant.b.amps, rng);
+        case AxisA::positionChan: return position.read(plant.bell.rod(0), rng);
+        case AxisB::positionChan: return position.read(plant.bell.rod(1), rng);
+    }
+    return 0;
+}
+
+int main (int argc, char** argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 10;
+    rng = Noise(argc > 2 ? atoi(argv[2]) : 1);
+    bool tune = false, kalman = false, mpc = false, jam = false, scan = false, capture = false;
+    bool schedule = false;
+    for (int i = 3; i < argc; ++i) {
+        tune |= strcmp(argv[i], "tune") == 0;
+        kalman |= strcmp(argv[i], "kalman") == 0;
+        mpc |= strcmp(argv[i], "mpc") == 0;
+        jam |= strcmp(argv[i], "jam") == 0;
+        scan |= strcmp(argv[i], "scan") == 0;
+        capture |= strcmp(argv[i], "capture") == 0;
+        schedule |= strcmp(argv[i], "schedule") == 0;
+    }
+
+    Sim::Machine& m = Sim::machine();
+    m.analog = analog;
+
+    //firmware start-up, as main() on the target would do it
+    Valves::init();
+    deadTime.init(Sim::cpuHz, 5000, 50000);
+    ValveFeedback::mode(Pinmode::in_pullup);
+    Exti<ValveFeedback>::init([]() {
+        Exti<ValveFeedback>::clear();
+        deadTime.moved(0);
+    });
+    trajectory.init(1, 20, 1000, 1000);
+    trajectory.reset(wanted);
+    allocator.init(0.15f / 1000);
+    allocator.reset(wanted);
+    gains(DriveA::cascade);
+    gains(DriveB::cascade);
+    bool stored = DriveA::loadGains<Store>(0) && DriveB::loadGains<Store>(1);
+    DriveA::init(PWM_HZ, 168000000, 84000000, 84000000);
+    DriveB::init(PWM_HZ, 168000000, 84000000, 84000000);
+    if (scan) {
+        static const uint8_t positions [] = { AxisA::positionChan, AxisB::positionChan };
+        AdcScan<AxisA::positionAdc>::init(positions, 2);
+    }
+    if (kalman) {
+        DriveA::cascade.track(position.noise * AxisA::metresPerCount, KALMAN_ACCEL, KALMAN_PER_AMP);
+        DriveB::cascade.track(position.noise * AxisA::metresPerCount, KALMAN_ACCEL, KALMAN_PER_AMP);
+    }
+    DriveA::cascade.watch(STALL_MS, STALL_AMPS, STALL_TRAVEL);
+    DriveB::cascade.watch(STALL_MS, STALL_AMPS, STALL_TRAVEL);
+    if (schedule) {
+        DriveA::cascade.schedule(&throttleGains, 0.02f);
+        DriveB::cascade.schedule(&throttleGains, 0.02f);
+    }
+    //a 5 ms lag fits the velocity loops best, the rod's own response to
+    //a setpoint step is slower but starts at once
+    MpcBuild table;
+    MpcTable mpcTable;
+    if (mpc) {
+        MpcParams p;
+        p.period = 1.0 / AxisA::positionHz;
+        p.lag = 0.005;
+        p.stroke = BellGimbal::stroke;
+        p.grid = 16;
+        table.build(p);
+        mpcTable = table.table();
+        DriveA::cascade.predictive(&mpcTable, POSITION_ZERO);
+        DriveB::cascade.predictive(&mpcTable, POSITION_ZERO);
+        printf("mpc: %u regions\n", mpcTable.regions);
+    }
+    VTableRam().adc = []() {
+        DriveA::currentIrq();
+        DriveB::currentIrq();
+    };
+    Loop::init(0, compute, actuate, 84000000, Sim::cpuHz);
+    nvicPriority(Timer<2>::irq, 4);
+
+    //the plant, stepped every 40 us
+    auto step = [&](uint32_t cycles) {
+        double dt = (double) cycles / Sim::cpuHz;
+        double a = m.duty(AxisA::pwmTimer, AxisA::pwmChannel) * (m.output('B', 1) ? -1 : 1);
+        double b = m.duty(AxisB::pwmTimer, AxisB::pwmChannel) * (m.output('B', 2) ? -1 : 1);
+        plant.step(a, b, m.output('A', 5), dt);
+        m.drive('B', 0, !plant.valve.open());
+    };
+
+    //relay of +/-20 mm/s, hysteresis of 5 counts, then the sweep
+    auto t0 = std::chrono::steady_clock::now();
+    int ms = 0;
+    if (tune) {
+        m.run(Sim::cpuHz / 5, Sim::cpuHz / 25000, step);
+        DriveA::cascade.autotune(0.02f, 50e-6f, RelayTune::ZN_PI);
+        DriveB::cascade.autotune(0.02f, 50e-6f, RelayTune::ZN_PI);
+        //the results go to flash as soon as each tune is done. The largest
+        //velocity setpoint step of actuator a in the 20 ms after its PID
+        //took over from the relay is kept, the relay itself steps 40 mm/s
+        bool saved [2] = {};
+        float set = 0, takeover = 0;
+        int tuned = -1;
+        for (ms = 200; ms < 60000 && (DriveA::cascade.relay.running() ||
+                                       DriveB::cascade.relay.running() || ms < tuned + 20); ++ms) {
+            m.run((uint64_t) (ms + 1) * (Sim::cpuHz / 1000), Sim::cpuHz / 25000, step);
+            float now = DriveA::cascade.velocitySet.read();
+            if (tuned >= 0 && ms > tuned && ms <= tuned + 20)
+                takeover = fmaxf(takeover, fabsf(now - set));
+            set = now;
+            if (DriveA::saveTuned<Store>(0)) {
+                saved[0] = true;
+                tuned = ms;
+            }
+            saved[1] |= DriveB::saveTuned<Store>(1);
+        }
+        for (int axis = 0; axis < 2; ++axis) {
+            Cascade const& c = axis ? DriveB::cascade : DriveA::cascade;
+            TunedGains const& g = c.relay.result;
+            TunedGains back {};
+            if (saved[axis])
+                printf("auto-tune: Ku %.1f, Tu %.1f ms, kp %.1f ki %.3f kd %.1f, %s\n",
+                        g.ku, 1e3 * g.tu / AxisA::positionHz, g.kp, g.ki, g.kd,
+                        Store::load(axis, back) && memcmp(&back, &g, sizeof g) == 0 ?
+                            "read back from flash" : "NOT IN FLASH");
+            else
+                printf("auto-tune failed, state %d\n", c.relay.state);
+        }
+        printf("takeover: largest velocity setpoint step %.1f mm/s\n", 1e3 * takeover);
+    }
+    if (stored)
+        printf("gains loaded from flash\n");
+
+    //track the true bell angles against the wanted ones after settling
+    double err2 = 0, errMax = 0, peakAmps = 0, vel2 = 0;
+    long samples = 0;
+    int jamAt = jam ? ms + seconds * 500 : -1, caught = -1;
+    for (int end = ms + seconds * 1000; ms < end; ) {
+        ++ms;
+        plant.a.seized = ms == jamAt || plant.a.seized;
+        m.run((uint64_t) ms * (Sim::cpuHz / 1000), Sim::cpuHz / 25000, step);
+        if (caught < 0 && DriveA::cascade.stall.fault != StallDetector<>::NONE)
+            caught = ms;
+        if (plant.a.seized)
+            continue;
+        if (Loop::ticks - start < 500)
+            continue;
+        double ep = plant.bell.pitch - wanted.pitch, ey = plant.bell.yaw - wanted.yaw;
+        double e = sqrt(ep * ep + ey * ey);
+        err2 += e * e;
+        errMax = fmax(errMax, e);
+        peakAmps = fmax(peakAmps, fmax(fabs(plant.a.amps), fabs(plant.b.amps)));
+        double ev = DriveA::cascade.vel - plant.bell.rodSpeed(0);
+        vel2 += ev * ev;
+        ++samples;
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    printf("simulated %.1f s in %.2f s, %.0fx real time\n", Sim::seconds(), wall, Sim::seconds() / wall);
+    printf("tracking error: rms %.2f mrad, max %.2f mrad, peak current %.1f A\n",
+            1e3 * sqrt(err2 / (samples ? samples : 1)), 1e3 * errMax, peakAmps);
+    printf("velocity estimate: rms error %.2f mm/s\n", 1e3 * sqrt(vel2 / (samples ? samples : 1)));
+    printf("loop: %u ticks, %u misses, %u overruns, compute peak %u cycles\n",
+            Loop::ticks, Loop::misses, Loop::overruns, Loop::stats[Loop::COMPUTE].peak);
+    char const* faults [] = { "none", "jam", "open" };
+    printf("stall: a %s, b %s", faults[DriveA::cascade.stall.fault], faults[DriveB::cascade.stall.fault]);
+    if (jam)
+        printf(", jammed at %.1f s, caught after %d ms, %.1f A when idled",
+                jamAt / 1000.0, caught - jamAt, fabs(plant.a.amps));
+    printf("\n");
+    if (schedule)
+        printf("schedule: position kp %.0f..%.0f over the throttle sweep\n", kpLow, kpHigh);
+    ValveParams v;
+    printf("valve latency: open %u us (model %.0f), close %u us (model %.0f), %u samples\n",
+            deadTime.openUs(0), 1e6 * (v.openDelay + v.travel / 2),
+            deadTime.closeUs(0), 1e6 * (v.closeDelay + v.travel / 2), deadTime.samples[0]);
+
+    //idle drives, then 10 % duty on actuator a: the current rises with the
+    //winding's time constant, 0.4 ms, recorded 1024 samples before the
+    //step to 2048 after
+    if (capture) {
+        DriveA::stop();
+        DriveB::stop();
+        uint64_t at = m.now + Sim::cpuHz / 20, tick = Sim::cpuHz / 10000;
+        m.run(at, Sim::cpuHz / 25000, step);
+        Capture::start(AxisA::currentChan, 1024, 2048);
+        m.run(at += 3 * tick, Sim::cpuHz / 25000, step);
+        double before = plant.a.amps;
+        MMIO32(DriveA::pwm::ccr(AxisA::pwmChannel)) = DriveA::period / 10;
+        Capture::trigger();
+        m.run(m.now + 2048 * (uint64_t) Sim::cpuHz / Capture::hz, Sim::cpuHz / 25000, step);
+        double after = plant.a.amps;
+        for (int i = 0; i < 100 && !Capture::done(); ++i)
+            m.run(at += tick, Sim::cpuHz / 25000, step);
+        Capture::send<Console>();
+
+        std::vector<uint8_t>& out = Console::out;
+        int count = 0, marked = 0, header = 0;
+        unsigned hz = 0, sum = 0, check = 0;
+        sscanf((char const*) out.data(), "capture %d %u %d\n%n", &count, &hz, &marked, &header);
+        std::vector<uint16_t> s (count);
+        for (int i = 0; i < count; ++i)
+            check += s[i] = out[header + 2 * i] | out[header + 2 * i + 1] << 8;
+        out.push_back(0);
+        sscanf((char const*) out.data() + header + 2 * count, "sum %u", &sum);
+        auto amps = [&](int from, int n) {
+            double a = 0;
+            for (int i = from; i < from + n; ++i)
+                a += (s[i] - AxisA::currentZero) * AxisA::ampsPerCount;
+            return fabs(a / n);
+        };
+        printf("capture: %d samples at %.1f MS/s, %s, %.2f A before the step (plant %.2f A), "
+                "%.2f A %.0f us after (plant %.2f A)\n", count, hz * 1e-6,
+                header && count > 256 && (check & 0xFFFF) == sum ? "sum ok" : "BAD BLOCK",
+                amps(0, marked), fabs(before), amps(count - 128, 128),
+                1e6 * (count - marked) / hz, fabs(after));
+    }
+    return 0;
+}
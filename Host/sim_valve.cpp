@@ -0,0 +1,257 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+//Valve program simulation: valve.c's loop, ValveLoop, runs unmodified on
+//the simulated registers of sim.h against the valve rig of plant.h, on
+//the same board: both ADC scans with their DMA, the slow filters, the
+//calibrated sensors, the dead-time estimator on the position switch and
+//the flow planner, pulsing the valve through its timer
+//The supply is 3.25 V, not the 3.3 V of the factory calibration, so the
+//absolute channels only read right through the cached VREFINT
+//The desired flow steps through fractions of the entry flow. Once the
+//estimates have settled, each pulse is checked: its width plus the close
+//latency less the open latency must be the planned flow time, and the
+//valve must pass flow for that long, from advance() after the command
+//With "peakhold" the board is valve.c built with -DVALVE_PEAK_HOLD: the
+//coil is driven peak-and-hold and its current signature, sampled on ADC2,
+//also feeds the open latency. The signature is checked against the rig
+//usage: sim_valve [seconds [seed [peakhold]]], exits 1 if a check fails
+
+#include <chrono>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+#include "plant.h"
+
+#include "Actuator Program/driver.h"
+#include "Actuator Program/loop.h"
+#include "Actuator Program/pins.h"
+#include "Actuator Program/valveloop.h"
+
+//Board: as valve.c, the valve on PA0 (TIM5 channel 1), its position
+//switch on PB0. coil() is the rig's view of the drive, a duty 0..1
+struct Board {
+    typedef ValvePulse<5,1,PinA<0>> valve;
+    typedef NoSignature signature;
+    typedef PinB<0> feedback;
+    enum { valveTimerHz = 84000000, loopHz = 2000, periodUs = 20000,
+           scanAdc = 1, scanSample = 0b111, entryChan = 1, supplyChan = 2,
+           slowAdc = 3, slowFrames = 64, slowBoxcar = 16, slowDecimate = 4,
+           pressureChan = 3, temperatureChan = 11,
+           supplyDivider = 11, chamberKpa = 1000, thermoMvPerC = 5, vrefRefreshTicks = 200,
+           responseUs = 5000, responseLimitUs = 50000, currentChan = 10 };
+
+    static void init () {}
+    static double coil (Sim::Machine& m) { return m.compareOutput(5, 1); }
+};
+
+//Peak-and-hold: the coil on PA8 (TIM1 channel 1) at 20 kHz, pulled in for
+//6 ms then held at 30 %, pulses timed by TIM5. TIM1 channel 2 samples the
+//current on ADC2 channel 10 (PC0) halfway through the hold on-time
+struct PeakHoldBoard : Board {
+    typedef PeakHold<1,1,PinA<8>> drive;
+    typedef PeakHoldPulse<drive,5> valve;
+    typedef CurrentSignature<1,2,2,currentChan> signature;
+
+    static void init () {
+        drive::init(20000, 6000, 30, Sim::cpuHz);
+        PinC<0>::mode(Pinmode::in_analog);
+        signature::init(drive::hold / 2, 50, 8, 20000);
+    }
+    static double coil (Sim::Machine& m) { return m.duty(1, 1); }
+};
+
+typedef ControlLoop<2,2000> Loop;
+
+//Analog front end: VDDA, VREFINT, the chip's sensor at 35 C, 0.76 V at
+//25 C and 2.5 mV/C, and factory values taken at 3.3 V. The coil current
+//through 0.1 ohm, amplified 10 times
+constexpr double VDDA = 3.25, VREF = 1.21, CHIP_C = 35, VOLTS_PER_AMP = 1;
+static double chipVolts (double c) { return 0.76 + 2.5e-3 * (c - 25); }
+uint16_t vrefint_cal = lround(VREF / 3.3 * 4095);
+uint16_t temp_30 = lround(chipVolts(30) / 3.3 * 4095);
+uint16_t temp_110 = lround(chipVolts(110) / 3.3 * 4095);
+
+//Desired flow, fractions of the entry flow for a second each: short
+//pulses held back, pulses, fully open, pulses again and closed
+constexpr double DESIRED [] = { 0.1, 0.25, 0.5, 0.75, 1, 0.5, 0 };
+constexpr double SETTLE = 2; //s before pulses are checked
+
+static ValveRig rig;
+static Noise rng;
+
+//Errors in us over the pulses checked
+struct Errors {
+    uint32_t n = 0;
+    double sum = 0, peak = 0;
+
+    void add (double e) {
+        ++n;
+        sum += fabs(e);
+        peak = fabs(e) > peak ? fabs(e) : peak;
+    }
+
+    double mean () const { return n ? sum / n : 0; }
+};
+
+//Volts at an ADC pin as counts against VDDA, 1 count of noise rms
+static uint16_t counts (double volts) {
+    return Sensor { VDDA / 4095, 0, 1 }.read(volts, rng);
+}
+
+static uint16_t analog (int, int chan) {
+    switch (chan) {
+        case Board::entryChan:       return counts(rig.p.entry * VDDA);
+        case Board::supplyChan:      return counts(rig.volts / Board::supplyDivider);
+        case Board::pressureChan:    return counts(VDDA * (0.1 + 0.8 * rig.kpa / Board::chamberKpa));
+        case Board::temperatureChan: return counts(Board::thermoMvPerC * 1e-3 * rig.celsius);
+        case Board::currentChan:     return counts(fmin(VOLTS_PER_AMP * rig.amps, VDDA));
+        case ADC<1>::tempChan:       return counts(chipVolts(CHIP_C));
+        case ADC<1>::vrefChan:       return counts(VREF);
+    }
+    return 0;
+}
+
+//Checks the current signature against the rig, nothing without one
+static bool checkSignature (NoSignature*) { return true; }
+
+template< typename S >
+static bool checkSignature (S*) {
+    ValveParams v;
+    SignatureStats s = const_cast<SignatureStats&>(S::stats);
+    double move = 1e6 * v.openDelay, seat = 1e6 * (v.openDelay + v.travel);
+    printf("current signature: %u events, %u misses, moving at %u us (model %.0f), "
+            "seated at %u us (model %.0f), %u..%u avg %u\n", s.events, s.misses,
+            s.moveUs, move, s.seatUs, seat, s.minUs, s.maxUs, s.avgUs);
+    //the latencies come in whole 50 us samples
+    return s.events > 0 && s.misses == 0 && fabs(s.avgUs - seat) <= 100 &&
+            fabs(s.moveUs - move) <= 100;
+}
+
+template< typename B >
+static int simulate (Sim::Machine& m, double seconds) {
+    typedef ValveLoop<B> Program;
+
+    //firmware start-up, as main() in valve.c does it
+    Program::init(Sim::cpuHz);
+    B::init();
+    Loop::init(Program::sense, Program::compute, Program::actuate, 84000000, Sim::cpuHz);
+
+    //the rig, stepped every 10 us, the coil on the valve's drive. Each
+    //pulse is timed from its command to the valve passing flow and back
+    //A pulse after a held period starts with the valve open, its flow
+    //runs from the start of the period
+    Errors flowTime, flowStart, afterHeld;
+    uint32_t widthMismatches = 0, pulses = 0;
+    double shortfall = 0;
+    bool coil = false, open = false, held = false, fromHeld = false;
+    uint64_t commandAt = 0, openAt = 0, periodAt = 0;
+    uint32_t planned = 0, advance = 0, heldPlanned = 0;
+    auto us = [](uint64_t cycles) { return (double) cycles * 1e6 / Sim::cpuHz; };
+    constexpr int PERIODS = sizeof DESIRED / sizeof DESIRED[0];
+    uint16_t desired [PERIODS];
+    for (int i = 0; i < PERIODS; ++i)
+        desired[i] = lround(DESIRED[i] * rig.p.entry * 4095);
+    auto step = [&](uint32_t cycles) {
+        Program::desired = desired[m.now / Sim::cpuHz % PERIODS];
+        double duty = B::coil(m);
+        bool energised = duty > 0;
+        rig.step(duty, (double) cycles / Sim::cpuHz);
+        m.drive('B', 0, !rig.valve.open());
+
+        bool checked = m.now > SETTLE * Sim::cpuHz && Program::flowUs < B::periodUs;
+        if (energised && !coil) {
+            commandAt = m.now;
+            planned = Program::flowUs;
+            advance = Program::deadTime.advance(0);
+            if (checked) {
+                uint32_t open = Program::deadTime.openUs(0), close = Program::deadTime.closeUs(0);
+                widthMismatches += Program::widthUs + close - open != planned;
+                shortfall += (double) open - close;
+                ++pulses;
+            }
+        }
+        if (held && !Program::held && Program::flowUs > 0) {
+            periodAt = m.now;
+            heldPlanned = Program::flowUs;
+            fromHeld = true;
+        }
+        held = Program::held;
+        if (rig.valve.open() && !open)
+            openAt = m.now;
+        if (!rig.valve.open() && open && fromHeld) {
+            afterHeld.add(us(m.now - periodAt) - heldPlanned);
+            fromHeld = false;
+        }
+        if (!rig.valve.open() && open && checked && planned == Program::flowUs) {
+            flowStart.add(us(openAt - commandAt) - advance);
+            flowTime.add(us(m.now - openAt) - planned);
+        }
+        coil = energised;
+        open = rig.valve.open();
+    };
+
+    auto t0 = std::chrono::steady_clock::now();
+    m.run((uint64_t) (seconds * Sim::cpuHz), Sim::cpuHz / 100000, step);
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    printf("simulated %.1f s in %.2f s, %.0fx real time\n", Sim::seconds(), wall, Sim::seconds() / wall);
+    printf("loop: %u ticks, %u misses, %u overruns, sense peak %u cycles\n",
+            Loop::ticks, Loop::misses, Loop::overruns, Loop::stats[Loop::SENSE].peak);
+    printf("supply: %.3f V (rig %.3f V), chip %.2f C (%.2f C)\n",
+            1e-3 * Program::units[Program::SENSE_SUPPLY], rig.volts,
+            1e-3 * Program::units[Program::SENSE_CHIP], CHIP_C);
+    printf("chamber: %.1f kPa (rig %.1f kPa), %.2f C (rig %.2f C)\n",
+            1e-3 * Program::units[Program::SENSE_PRESSURE], rig.kpa,
+            1e-3 * Program::units[Program::SENSE_TEMPERATURE], rig.celsius);
+    ValveParams v;
+    printf("valve latency: open %u us (model %.0f), close %u us (model %.0f), %u samples\n",
+            Program::deadTime.openUs(0), 1e6 * (v.openDelay + v.travel / 2),
+            Program::deadTime.closeUs(0), 1e6 * (v.closeDelay + v.travel / 2),
+            Program::deadTime.samples[0]);
+    bool signature = checkSignature((typename B::signature*) 0);
+    printf("pulses: %u checked, width + close - open != planned for %u\n", pulses, widthMismatches);
+    printf("flow time vs planned: mean %.1f us, max %.1f us, over %u pulses\n",
+            flowTime.mean(), flowTime.peak, flowTime.n);
+    printf("flow start vs advance(): mean %.1f us, max %.1f us\n", flowStart.mean(), flowStart.peak);
+    printf("after holding open: flow time vs planned: mean %.1f us, max %.1f us, over %u pulses\n",
+            afterHeld.mean(), afterHeld.peak, afterHeld.n);
+    printf("uncompensated, each pulse would pass %.0f us less flow\n", pulses ? shortfall / pulses : 0);
+    return !signature || widthMismatches != 0 || flowTime.n == 0 || flowTime.peak > 50 ||
+            afterHeld.peak > 50;
+}
+
+int main (int argc, char** argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 10;
+    rng = Noise(argc > 2 ? atoi(argv[2]) : 1);
+    bool peakHold = false;
+    for (int i = 3; i < argc; ++i)
+        peakHold |= strcmp(argv[i], "peakhold") == 0;
+
+    Sim::Machine& m = Sim::machine();
+    m.analog = analog;
+    return peakHold ? simulate<PeakHoldBoard>(m, seconds) : simulate<Board>(m, seconds);
+}
@@ -0,0 +1,266 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+//Monte Carlo tuning of the actuator loops, kinematics and valve planner
+//Random candidate settings, each run against the same set of randomised
+//plants, spread over all cores with a work-stealing pool. The controllers
+//are the Control/ classes stepped at the firmware rates, without the
+//register layer of sim.h, so runs are independent and thread-safe
+//usage: tune [candidates [variations [seconds [threads [file]]]]]
+//Candidate 0 holds the gains of sim_gimbal.cpp, as a baseline
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdlib.h>
+#include <vector>
+
+#include "Control/cascade.h"
+#include "Control/kinematics.h"
+#include "Control/planner.h"
+#include "plant.h"
+#include "pool.h"
+#include "tune.h"
+
+//Firmware rates, all multiples of the 20 kHz current loop
+constexpr int TICK_HZ = 20000;
+constexpr int VELOCITY_DIV = 10, POSITION_DIV = 40, APP_DIV = 20;
+constexpr double AMPS_PER_COUNT = 20.0 / 2048, METRES_PER_COUNT = 10e-6;
+constexpr double POSITION_ZERO = 2048 * METRES_PER_COUNT;
+
+//Valve: 50 Hz PWM of an entry flow, wanted flow stepping every 10 periods
+constexpr uint32_t VALVE_PERIOD = 20000;
+constexpr uint16_t ENTRY_FLOW = 40000;
+constexpr uint16_t FLOWS [] = { 2000, 8000, 20000, 32000, 39000 };
+
+static TuneCandidate baseline () {
+    TuneCandidate c;
+    c.posKp = 250;
+    c.velKp = 60;
+    c.velKi = 1;
+    c.curKp = 0.05f;
+    c.curKi = 0.006f;
+    c.filter = 0.2f;
+    c.response = 5000;
+    c.lead = 0;
+    c.table = 1;
+    return c;
+}
+
+template< typename R >
+static float logUniform (R& rng, double lo, double hi) {
+    return lo * pow(hi / lo, std::uniform_real_distribution<double>(0, 1)(rng));
+}
+
+template< typename R >
+static float uniform (R& rng, double lo, double hi) {
+    return std::uniform_real_distribution<double>(lo, hi)(rng);
+}
+
+template< typename R >
+static TuneCandidate candidate (R& rng) {
+    TuneCandidate c;
+    c.posKp = logUniform(rng, 100, 400);
+    c.velKp = logUniform(rng, 20, 150);
+    c.velKi = logUniform(rng, 0.2, 4);
+    c.curKp = logUniform(rng, 0.02, 0.1);
+    c.curKi = logUniform(rng, 0.002, 0.015);
+    c.filter = logUniform(rng, 0.05, 0.5);
+    c.response = uniform(rng, 1000, 6000);
+    c.lead = uniform(rng, -1500, 1500);
+    c.table = rng() & 1;
+    return c;
+}
+
+template< typename R >
+static TuneVariation variation (R& rng) {
+    TuneVariation v;
+    v.inertia = logUniform(rng, 0.01, 0.04);
+    v.coulomb = logUniform(rng, 0.005, 0.03);
+    v.viscous = logUniform(rng, 1e-6, 5e-6);
+    v.backlash = uniform(rng, 0, 60e-6);
+    v.torque = uniform(rng, -1, 1);
+    v.posNoise = uniform(rng, 0.3, 2);
+    v.curNoise = uniform(rng, 0.5, 4);
+    v.openDelay = uniform(rng, 2.5e-3, 6e-3);
+    v.closeDelay = uniform(rng, 1.5e-3, 4e-3);
+    v.seed = rng();
+    return v;
+}
+
+static void setup (Cascade& k, TuneCandidate const& c) {
+    k.init(TICK_HZ / VELOCITY_DIV, c.filter);
+    k.current.init(c.curKp, c.curKi, 0, 1, -0.95f, 0.95f, 1);
+    k.velocity.init(c.velKp, c.velKi, 0, 1, -15, 15, 2);
+    k.position.init(c.posKp, 0, 0, 1, -0.2f, 0.2f, 1);
+}
+
+//One closed-loop run, same trajectory as sim_gimbal.cpp
+static TuneRecord simulate (TuneCandidate const& c, TuneVariation const& v, double seconds) {
+    GimbalPlant plant;
+    plant.bell.p.inertia = v.inertia;
+    plant.bell.p.torque = v.torque;
+    for (Actuator* a : { &plant.a, &plant.b }) {
+        a->p.coulomb = v.coulomb;
+        a->p.viscous = v.viscous;
+        a->p.backlash = v.backlash;
+    }
+    plant.valve.p.openDelay = v.openDelay;
+    plant.valve.p.closeDelay = v.closeDelay;
+
+    Noise noise (v.seed);
+    const Sensor current { AMPS_PER_COUNT, 2048, v.curNoise };
+    const Sensor position { METRES_PER_COUNT, 2048, v.posNoise };
+
+    Cascade axis [2];
+    setup(axis[0], c);
+    setup(axis[1], c);
+    FlowPlanner<VALVE_PERIOD> planner;
+
+    TuneRecord r {};
+    constexpr double dt = 1.0 / TICK_HZ;
+    constexpr int periodTicks = VALVE_PERIOD * TICK_HZ / 1000000;
+    double err2 = 0, wanted = 0, delivered = 0;
+    long samples = 0, ticks = seconds * TICK_HZ;
+    GimbalAngles g {};
+    int32_t on = 0;
+    uint16_t flow = 0;
+
+    for (long t = 0; t < ticks; ++t) {
+        if (t % APP_DIV == 0) {
+            double s = (double) t / TICK_HZ;
+            g.pitch = 0.10f * sinf(2 * M_PI * 0.5 * s);
+            g.yaw = 0.06f * sinf(2 * M_PI * 1.3 * s);
+            ActuatorLengths l = c.table ? Kinematics<>::lookup(g) : Kinematics<>::inverse(g);
+            axis[0].target.write(l.a - BellGimbal::length + POSITION_ZERO);
+            axis[1].target.write(l.b - BellGimbal::length + POSITION_ZERO);
+        }
+        if (t % POSITION_DIV == 0) {
+            axis[0].positionTick();
+            axis[1].positionTick();
+        }
+        if (t % VELOCITY_DIV == 0)
+            for (int i = 0; i < 2; ++i)
+                axis[i].velocityTick(position.read(plant.bell.rod(i), noise) * METRES_PER_COUNT);
+        if (t % periodTicks == 0) {
+            flow = FLOWS[t / periodTicks / 10 % 5];
+            Pulse p = planner.plan(ENTRY_FLOW, c.response, flow);
+            on = p.open > 0 ? (int32_t) p.open + (int32_t) c.lead : 0;
+        }
+
+        double ia = (current.read(plant.a.amps, noise) - 2048) * AMPS_PER_COUNT;
+        double ib = (current.read(plant.b.amps, noise) - 2048) * AMPS_PER_COUNT;
+        double da = axis[0].currentTick(ia), db = axis[1].currentTick(ib);
+        bool coil = (t % periodTicks) * (1000000 / TICK_HZ) < on;
+        plant.step(da, db, coil, dt);
+
+        wanted += flow * dt;
+        delivered += plant.valve.position * ENTRY_FLOW * dt;
+        if (!(fabs(plant.bell.pitch) < 0.5 && fabs(plant.bell.yaw) < 0.5)) {
+            r.failed = 1;
+            return r;
+        }
+        if (t >= TICK_HZ / 2 && t % APP_DIV == 0) {
+            double ep = plant.bell.pitch - g.pitch, ey = plant.bell.yaw - g.yaw;
+            double e = ep * ep + ey * ey;
+            err2 += e;
+            r.max = fmax(r.max, 1e3 * sqrt(e));
+            ++samples;
+        }
+        r.amps = fmax(r.amps, fmax(fabs(plant.a.amps), fabs(plant.b.amps)));
+    }
+    r.rms = 1e3 * sqrt(err2 / (samples ? samples : 1));
+    r.flow = 100 * fabs(delivered - wanted) / wanted;
+    return r;
+}
+
+int main (int argc, char** argv) {
+    int candidates = argc > 1 ? atoi(argv[1]) : 64;
+    int variations = argc > 2 ? atoi(argv[2]) : 16;
+    double seconds = argc > 3 ? atof(argv[3]) : 2;
+    int threads = argc > 4 ? atoi(argv[4]) : std::thread::hardware_concurrency();
+    char const* path = argc > 5 ? argv[5] : "build/tune.bin";
+    uint32_t seed = 1;
+    if (candidates < 1 || variations < 1) {
+        fprintf(stderr, "tune: needs at least one candidate and one variation\n");
+        return 1;
+    }
+
+    std::mt19937 rng (seed);
+    std::vector<TuneCandidate> cand (candidates);
+    std::vector<TuneVariation> var (variations);
+    cand[0] = baseline();
+    for (int i = 1; i < candidates; ++i)
+        cand[i] = candidate(rng);
+    for (auto& v : var)
+        v = variation(rng);
+
+    std::vector<TuneRecord> rec ((size_t) candidates * variations);
+    WorkPool pool (threads);
+    auto t0 = std::chrono::steady_clock::now();
+    pool.run(rec.size(), [&](int run, int) {
+        rec[run] = simulate(cand[run / variations], var[run % variations], seconds);
+    });
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    TuneHeader h { { 'T', 'V', 'C', 'T' }, 1, sizeof (TuneRecord),
+                   (uint32_t) candidates, (uint32_t) variations, seed, (float) seconds };
+    if (!writeTune(path, h, cand.data(), var.data(), rec.data())) {
+        fprintf(stderr, "tune: can't write %s\n", path);
+        return 1;
+    }
+    printf("%zu runs of %.1f s on %d threads in %.2f s, %.0f runs/s, %llu steals -> %s\n",
+            rec.size(), seconds, pool.size(), wall, rec.size() / wall,
+            (unsigned long long) pool.steals, path);
+
+    //Rank by worst-case tracking over the plants, failures last
+    struct Score { int c, failed; float worst, mean, flow; };
+    std::vector<Score> score (candidates);
+    for (int c = 0; c < candidates; ++c) {
+        Score& s = score[c];
+        s = { c, 0, 0, 0, 0 };
+        for (int v = 0; v < variations; ++v) {
+            TuneRecord const& r = rec[(size_t) c * variations + v];
+            s.failed += r.failed;
+            s.worst = fmaxf(s.worst, r.rms);
+            s.mean += r.rms / variations;
+            s.flow += r.flow / variations;
+        }
+    }
+    std::sort(score.begin(), score.end(), [](Score const& a, Score const& b) {
+        return a.failed != b.failed ? a.failed < b.failed : a.worst < b.worst;
+    });
+    printf("  cand  fail  worst mrad  mean mrad  flow err %%   posKp  velKp velKi  curKp  curKi filter table\n");
+    for (int i = 0; i < candidates; ++i) {
+        Score const& s = score[i];
+        if (i >= 5 && s.c != 0)
+            continue;
+        TuneCandidate const& c = cand[s.c];
+        printf("%6d %5d %11.2f %10.2f %11.2f %7.0f %6.1f %5.2f %6.3f %6.4f %6.2f %5u\n",
+                s.c, s.failed, s.worst, s.mean, s.flow,
+                c.posKp, c.velKp, c.velKi, c.curKp, c.curKi, c.filter, c.table);
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+/*MIT License
+
+Copyright (c) 2020 Nyameaama Gambrah
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.*/
+
+
+
+//Result file of a tuning sweep, written by tune.cpp
+//Layout, little-endian, no padding between the parts:
+//  TuneHeader
+//  TuneCandidate [candidates]     controller settings under test
+//  TuneVariation [variations]     randomised plants, shared by all candidates
+//  TuneRecord [candidates * variations], candidate-major
+//Each record is one closed-loop run of a candidate on a variation
+
+#ifndef HOST_TUNE_
+#define HOST_TUNE_
+
+#include <stdint.h>
+#include <stdio.h>
+
+struct TuneHeader {
+    char magic [4];             //"TVCT"
+    uint16_t version;           //1
+    uint16_t recordSize;        //sizeof (TuneRecord)
+    uint32_t candidates, variations;
+    uint32_t seed;
+    float seconds;              //simulated per run
+};
+
+struct TuneCandidate {
+    float posKp;                //position loop, m/s per m
+    float velKp, velKi;         //velocity loop, A per m/s
+    float curKp, curKi;         //current loop, duty per A
+    float filter;               //velocity smoothing, see Cascade::init()
+    float response;             //valve response given to the flow planner, us
+    float lead;                 //added to every valve open time, us
+    uint32_t table;             //1 = Kinematics::lookup(), 0 = inverse()
+};
+
+struct TuneVariation {
+    float inertia;              //bell, kg m^2
+    float coulomb, viscous;     //actuator motor friction, Nm and Nm s/rad
+    float backlash;             //m
+    float torque;               //side load on pitch, Nm
+    float posNoise, curNoise;   //rms ADC counts
+    float openDelay, closeDelay;//valve dead times, s
+    uint32_t seed;              //sensor noise
+};
+
+struct TuneRecord {
+    float rms, max;             //gimbal tracking error, mrad
+    float amps;                 //peak actuator current
+    float flow;                 //valve flow error, % of the wanted total
+    uint32_t failed;            //1 = went unstable, the rest is not valid
+};
+
+static_assert(sizeof (TuneHeader) == 24 && sizeof (TuneCandidate) == 36 &&
+              sizeof (TuneVariation) == 40 && sizeof (TuneRecord) == 20,
+              "result file layout");
+
+inline bool writeTune (char const* path, TuneHeader const& h, TuneCandidate const* c,
+                        TuneVariation const* v, TuneRecord const* r) {
+    FILE* f = fopen(path, "wb");
+    if (f == 0)
+        return false;
+    size_t runs = (size_t) h.candidates * h.variations;
+    bool ok = fwrite(&h, sizeof h, 1, f) == 1 &&
+              fwrite(c, sizeof *c, h.candidates, f) == h.candidates &&
+              fwrite(v, sizeof *v, h.variations, f) == h.variations &&
+              fwrite(r, sizeof *r, runs, f) == runs;
+    return fclose(f) == 0 && ok;
+}
+
+#endif //HOST_TUNE
@@ -16,16 +16,11 @@
 #define TS_CAL1             0x1FFF7A2C                  // Temp @  30 C [2] p. 138
 #define TS_CAL2             0x1FFF7A2E                  // Temp @ 110 C [2] p. 138
 
+// factory calibration, 12-bit counts taken at VDDA = 3.3 V
 extern uint16_t vrefint_cal;  // read VREFINT_CAL_ADDR memory location
 extern uint16_t temp_30;
 extern uint16_t temp_110;
 
-// These values can be found in [2] p. 138
-#define AVG_SLOPE   2.5     // mV/C
-#define V_25        760.0   // 760 mV or 0.76V
-
-extern uint16_t vrefint_cal;
-
 namespace Periph {
     constexpr uint32_t rtc   = 0x40002800;
     constexpr uint32_t pwr   = 0x40007000;
@@ -35,7 +30,7 @@ namespace Periph {
     constexpr uint32_t fsmc  = 0xA0000000;
     constexpr uint32_t dwt   = 0xE0001000;
 
-    inline volatile uint32_t& bit (uint32_t a, int b) {
+    inline auto bit (uint32_t a, int b) -> decltype(MMIO32(0)) {
         return MMIO32(0x42000000 + ((a & 0xFFFFF) << 5) + (b << 2));
     }
 }
@@ -66,6 +61,12 @@ struct VTable {
         lcd_tft, lcd_tft_err, dma2d;
 };
 
+// nvic priority of an interrupt, 0 (highest) .. 15, all start at 0
+
+inline void nvicPriority (int irq, int prio) {
+    MMIO8(0xE000E400 + irq) = prio << 4;
+}
+
 // systick and delays
 
 constexpr static int defaultHz = 16000000;
@@ -313,26 +314,120 @@ void enableClkAt168MHz();
 
 int fullSpeedClock();
 
+// dma streams, D = 1 or 2, S = 0..7 [1] p.304
+
+template< int D, int S >
+struct DmaStream {
+    constexpr static uint32_t base = D == 1 ? 0x40026000 : 0x40026400;
+    constexpr static uint32_t isr  = base + (S < 4 ? 0x00 : 0x04);
+    constexpr static uint32_t ifcr = base + (S < 4 ? 0x08 : 0x0C);
+    constexpr static uint32_t cr   = base + 0x10 + 0x18*S;
+    constexpr static uint32_t ndtr = cr + 0x04;
+    constexpr static uint32_t par  = cr + 0x08;
+    constexpr static uint32_t m0ar = cr + 0x0C;
+    constexpr static uint32_t m1ar = cr + 0x10;
+    constexpr static uint32_t fcr  = cr + 0x14;
+
+    // position of this stream's flags in isr/ifcr: 0, 6, 16, or 22
+    constexpr static int shift = 6*(S&1) + 16*((S>>1)&1);
+    constexpr static int irq = D == 1 ? (S < 7 ? 11 + S : 47) :
+                                        (S < 5 ? 56 + S : 63 + S);
+
+    // cr settings for init()
+    enum {
+        irqHalf   = 1<<3,   // HTIE
+        irqDone   = 1<<4,   // TCIE
+        toPeriph  = 1<<6,   // else peripheral to memory
+        circular  = 1<<8,
+        memInc    = 1<<10,
+        halfWords = (1<<13) | (1<<11),  // MSIZE, PSIZE
+        words     = (2<<13) | (2<<11),
+        high      = 2<<16,  // PL
+        doubleBuf = 1<<18,  // DBM, alternates between mem and mem1
+    };
+
+    // status flags
+    enum { halfDone = 1<<4, done = 1<<5, error = 1<<3 };
+
+    static void init (int chan, uint32_t periph, void const* mem, uint16_t count,
+                        uint32_t mode, void const* mem1 =0) {
+        Periph::bit(Periph::rcc+0x30, 20+D) = 1; // DMA1EN, DMA2EN
+        Periph::bit(cr, 0) = 0;
+        while (Periph::bit(cr, 0)) {}
+        clear();
+        MMIO32(par) = periph;
+        MMIO32(m0ar) = (uint32_t) (uintptr_t) mem;
+        MMIO32(m1ar) = (uint32_t) (uintptr_t) mem1;
+        MMIO32(ndtr) = count;
+        MMIO32(cr) = (chan << 25) | mode;
+        Periph::bit(cr, 0) = 1; // EN
+    }
+
+    static void interrupt (VTable::Handler handler) {
+        VTable& vt = VTableRam();
+        switch (8*D + S) {
+            case  8: vt.dma1_stream0 = handler; break;
+            case  9: vt.dma1_stream1 = handler; break;
+            case 10: vt.dma1_stream2 = handler; break;
+            case 11: vt.dma1_stream3 = handler; break;
+            case 12: vt.dma1_stream4 = handler; break;
+            case 13: vt.dma1_stream5 = handler; break;
+            case 14: vt.dma1_stream6 = handler; break;
+            case 15: vt.dma1_stream7 = handler; break;
+            case 16: vt.dma2_stream0 = handler; break;
+            case 17: vt.dma2_stream1 = handler; break;
+            case 18: vt.dma2_stream2 = handler; break;
+            case 19: vt.dma2_stream3 = handler; break;
+            case 20: vt.dma2_stream4 = handler; break;
+            case 21: vt.dma2_stream5 = handler; break;
+            case 22: vt.dma2_stream6 = handler; break;
+            case 23: vt.dma2_stream7 = handler; break;
+        }
+
+        constexpr uint32_t nvic_iser = 0xE000E100;
+        MMIO32(nvic_iser + 4*(irq>>5)) = 1 << (irq & 0x1F);
+    }
+
+    static uint32_t flags () { return (MMIO32(isr) >> shift) & 0x3D; }
+    static void clear () { MMIO32(ifcr) = 0x3D << shift; }
+
+    // transfers left before wrapping, counts down from "count"
+    static uint16_t remaining () { return MMIO32(ndtr); }
+
+    // in double buffer mode: 0 = filling mem, 1 = filling mem1
+    static int target () { return Periph::bit(cr, 19); }
+};
+
 // analog input using ADC1, ADC2, ADC3
 
 template< int N >
 struct ADC {
     constexpr static uint32_t base = 0x40012000 + 0x100 * (N - 1);   // [1] pp. 66, 430, 432
     constexpr static uint32_t sr = base + 0x00;
-    constexpr static uint32_t ccr = base + 0x04 + 0x300;    // [1] p. 427
+    constexpr static uint32_t ccr = 0x40012000 + 0x304;     // common to all, [1] p. 427
+    constexpr static uint32_t cdr = 0x40012000 + 0x308;     // common data of multi-ADC modes
     constexpr static uint32_t cr1 = base + 0x04;
     constexpr static uint32_t cr2 = base + 0x08;
     constexpr static uint32_t smpr1 = base + 0x0C;
     constexpr static uint32_t smpr2 = base + 0x10;
+    constexpr static uint32_t sqr1 = base + 0x2C;
+    constexpr static uint32_t sqr2 = base + 0x30;
     constexpr static uint32_t sqr3 = base + 0x34;
+    constexpr static uint32_t jsqr = base + 0x38;
+    constexpr static uint32_t jdr1 = base + 0x3C;
     constexpr static uint32_t dr = base + 0x4C;
+    // ADCPRE /4: 21 MHz from the 84 MHz APB2 of fullSpeedClock(), the
+    // highest that stays within the 36 MHz limit of fADC, [2] ADC characteristics
+    constexpr static uint32_t clockHz = 21000000;
 
+    // safe to call again, e.g. by two users of one ADC: conversions and
+    // triggers set up earlier are kept, only temp/vref sampling is reset
     static void init(int samplingTime=0b111) {
         // ADC is on bus APB2 ([1] p 66)
         Periph::bit(Periph::rcc + 0x44, (N - 1) + 8) = 1;   // enable ADC 1, 2, or 3; [1] p. 187
         // TSVREFE and ADON must be started at the same time. See [1] p. 413
-        MMIO32(ccr) = (1 << 23);                 // TSVREFE [1] p. 427
-        MMIO32(cr2) = (1 << 0);                  // ADON [1] p. 420
+        MMIO32(ccr) = (MMIO32(ccr) & ~(3 << 16)) | (1 << 23) | (1 << 16); // TSVREFE, ADCPRE /4 [1] p. 427
+        MMIO32(cr2) |= (1 << 0);                 // ADON [1] p. 420
         
         // Following lines are copied over from STM32F1, but apparently no calibration needed for F4
 
@@ -340,9 +435,9 @@ struct ADC {
         // and to ADC1_IN18 for the STM32F42x and STM32F43x devices. ([1] p. 413)
         // Sampling time ranges from 0b000 (3 cycles) to 0b111 (480 cyles)
 #if STM23F40X || STM32F41X
-        MMIO32(smpr1) = (samplingTime << 21) | (7 << 18);  // slow temp/vref conversions [1] p.420
+        MMIO32(smpr1) = (MMIO32(smpr1) & ~(077 << 18)) | (samplingTime << 21) | (7 << 18);  // slow temp/vref conversions [1] p.420
 #elif STM32F42X || STM32F43X
-        MMIO32(smpr1) = (samplingTime << 21) | (7 << 24);  // slow temp/vref conversions [1] p.420
+        MMIO32(smpr1) = (MMIO32(smpr1) & ~(077 << 21)) | (samplingTime << 21) | (7 << 24);  // slow temp/vref conversions [1] p.420
 #else
 #error Please specify microcontroller model. Currently supported: STM23F40X, STM32F41X, STM32F42X, STM32F43X
 #endif
@@ -368,32 +463,149 @@ struct ADC {
         return MMIO32(dr);
     }
 
-    static double temperature()
-    {
-        if (N == 1) // temperature only available on ADC1 (TODO: source needed)
-        {
-            // For source of temperature formula, see [1] p. 413, [2] p. 138
-            // According to the reference manual, it should be:
-            //   Temperature (in *C) = {(VSENSE - V25) / Avg_Slope} + 25
-            return (((double)read(16) * vref() / 4095 - V_25) / AVG_SLOPE) + 25.00;
-        }
-        else
-        {
-            return -1.0;
-        }
+    // dma stream and channel serving this ADC [1] p.308
+    typedef DmaStream<2, N == 1 ? 0 : N == 2 ? 2 : 1> dma;
+    constexpr static int dmaChan = N - 1;
+
+    // regular trigger source (EXTSEL) for an event of timer "tim": channel
+    // "ch" compare, or TRGO when ch is 0. -1 if there is none [1] p.422
+    constexpr static int timerEvent (int tim, int ch) {
+        return tim == 1 ? (ch >= 1 && ch <= 3 ? ch - 1 : -1) :
+               tim == 2 ? (ch == 0 ? 6 : ch >= 2 ? ch + 1 : -1) :
+               tim == 3 ? (ch == 0 ? 8 : ch == 1 ? 7 : -1) :
+               tim == 4 ? (ch == 4 ? 9 : -1) :
+               tim == 5 ? (ch >= 1 && ch <= 3 ? ch + 9 : -1) :
+               tim == 8 ? (ch == 0 ? 14 : ch == 1 ? 13 : -1) :
+                          -1;
     }
 
-    static double vref()
-    {
-        if (N == 1) // vref only available on ADC1 (TODO: source needed)
-        {
-            double vrefUnscaled = vrefint_cal / (double)read(17);
-            return 3300 * vrefUnscaled; // vref
-        }
-        else
-        {
-            return -1.0;
-        }
+    // injected trigger source (JEXTSEL) for an event of timer "tim": channel
+    // "ch" compare, or TRGO when ch is 0. -1 if there is none [1] p.422
+    constexpr static int injectedEvent (int tim, int ch) {
+        return tim == 1 ? (ch == 4 ? 0 : ch == 0 ? 1 : -1) :
+               tim == 2 ? (ch == 1 ? 2 : ch == 0 ? 3 : -1) :
+               tim == 3 ? (ch == 2 ? 4 : ch == 4 ? 5 : -1) :
+               tim == 4 ? (ch == 0 ? 9 : ch <= 3 ? ch + 5 : -1) :
+               tim == 5 ? (ch == 4 ? 10 : ch == 0 ? 11 : -1) :
+               tim == 8 ? (ch >= 2 ? ch + 10 : -1) :
+                          -1;
+    }
+
+    // sampling time of a channel, 0b000 (3 cycles) .. 0b111 (480 cycles)
+    static void sampleTime (uint8_t chan, int t) {
+        uint32_t smpr = chan < 10 ? smpr2 : smpr1;
+        int shift = 3 * (chan < 10 ? chan : chan - 10);
+        MMIO32(smpr) = (MMIO32(smpr) & ~(7 << shift)) | (t << shift);
+    }
+
+    // convert "chan" on every trigger event, results go out through DMA
+    // extsel: see timerEvent(), edge: 1 rising, 2 falling, 3 both
+    // without dma, read dr from the interrupt() handler instead
+    static void trigger (uint8_t chan, int extsel, int edge =1, bool dma =true) {
+        MMIO32(sqr3) = chan;
+        // EXTEN, EXTSEL, DDS, DMA, ADON [1] p.420, keeps the injected trigger
+        MMIO32(cr2) = (MMIO32(cr2) & (0x3F<<16)) | (edge << 28) | (extsel << 24) |
+                      (dma ? (1<<9) | (1<<8) : 0) | (1<<0);
+    }
+
+    // convert "chan" as an injected conversion on every trigger event, the
+    // result lands in jdr1. Injected conversions interrupt regular ones,
+    // which restart afterwards, so a scan can keep running on this ADC
+    // jextsel: see injectedEvent(), edge: 1 rising, 2 falling, 3 both
+    static void inject (uint8_t chan, int jextsel, int edge =1) {
+        MMIO32(jsqr) = chan << 15;  // JL = 0: one conversion, from JSQ4 [1] p.425
+        // JEXTEN, JEXTSEL, ADON [1] p.420
+        MMIO32(cr2) = (MMIO32(cr2) & ~(0x3F<<16)) | (edge << 20) | (jextsel << 16) | (1<<0);
+    }
+
+    // convert a list of up to 16 channels back to back, over and over
+    // when continuous, results go out through DMA, one transfer each
+    static void scan (uint8_t const* chans, int count, bool continuous =true) {
+        uint32_t sq [3] = { (uint32_t) (count - 1) << 20, 0, 0 };  // L in sqr1
+        for (int i = 0; i < count; ++i)
+            sq[2 - i / 6] |= chans[i] << 5 * (i % 6);   // SQ1..6 in sqr3
+        MMIO32(sqr1) = sq[0];
+        MMIO32(sqr2) = sq[1];
+        MMIO32(sqr3) = sq[2];
+        Periph::bit(cr1, 8) = 1;    // SCAN [1] p.418
+        // DDS, DMA, CONT, ADON [1] p.420, keeps the injected trigger
+        MMIO32(cr2) = (MMIO32(cr2) & (0x3F<<16)) | (1<<9) | (1<<8) |
+                      (continuous ? 1<<1 : 0) | (1<<0);
+        Periph::bit(cr2, 30) = 1;   // SWSTART
+    }
+
+    // triple interleaved conversions of "chan" on ADC1..3, each ADC starting
+    // "delay" (5..20) ADC clocks after the previous one: clockHz / delay,
+    // 4.2 MS/s at delay 5. Results come out of cdr through the dma stream
+    // of ADC1, one word of two samples per request, in time order low half
+    // first (DMA mode 2). Takes over the regular groups of all three and
+    // turns their triggers off, independent() ends the mode
+    static void interleave (uint8_t chan, int delay =5) {
+        ADC<1>::shareChannel(chan);
+        ADC<2>::shareChannel(chan);
+        ADC<3>::shareChannel(chan);
+        // DMA mode 2, DDS, DELAY, MULTI = triple interleaved [1] p.427
+        MMIO32(ccr) = (MMIO32(ccr) & ~0xEF1F) | (2<<14) | (1<<13) | ((delay - 5) << 8) | 0b10111;
+        MMIO32(ADC<1>::cr2) = (1<<1) | (1<<0); // CONT, ADON
+        Periph::bit(ADC<1>::cr2, 30) = 1; // SWSTART, the master starts all three
+    }
+
+    // stop the conversions of a multi-ADC mode, the ADCs work on their own again
+    static void independent () {
+        Periph::bit(ADC<1>::cr2, 1) = 0; // CONT
+        MMIO32(ccr) &= ~0xEF1F; // DMA, DDS, DELAY, MULTI
+    }
+
+    // one channel, fastest sampling, no triggers: a member of an interleave
+    static void shareChannel (uint8_t chan) {
+        init();
+        sampleTime(chan, 0b000);
+        MMIO32(sqr1) = 0;
+        MMIO32(sqr3) = chan;
+        Periph::bit(cr1, 8) = 0; // SCAN
+        MMIO32(cr2) = (1<<0); // ADON
+    }
+
+    // interrupt at the end of each regular conversion
+    // ADC1..3 share one vector, the last interrupt() call wins
+    static void interrupt (VTable::Handler handler) {
+        constexpr int irq = 18;
+        VTableRam().adc = handler;
+        MMIO32(0xE000E100) = 1 << irq;
+        Periph::bit(cr1, 5) = 1; // EOCIE
+    }
+
+    // interrupt at the end of each injected sequence, on the same vector
+    // JEOC is not cleared by reading jdr1, write 0 to sr bit 2 to clear it
+    static void injectedInterrupt (VTable::Handler handler) {
+        constexpr int irq = 18;
+        VTableRam().adc = handler;
+        MMIO32(0xE000E100) = 1 << irq;
+        Periph::bit(cr1, 7) = 1; // JEOCIE
+    }
+
+    // internal channels: temperature sensor ([1] p. 413) and VREFINT
+#if STM32F42X || STM32F43X
+    constexpr static uint8_t tempChan = 18;
+#else
+    constexpr static uint8_t tempChan = 16;
+#endif
+    constexpr static uint8_t vrefChan = 17;
+
+    // supply voltage VDDA in mV, from VREFINT against its calibration
+    // ADC1 only, a blocking conversion
+    static uint32_t vref() {
+        static_assert(N == 1, "VREFINT is only on ADC1");
+        return 3300 * vrefint_cal / read(vrefChan);
+    }
+
+    // chip temperature in thousandths of a degree C, on a line through the
+    // factory points at 30 and 110 C ([2] p. 138), the reading scaled to
+    // the 3.3 V they were taken at. ADC1 only, two blocking conversions
+    static int32_t temperature() {
+        static_assert(N == 1, "the temperature sensor is only on ADC1");
+        int32_t raw = read(tempChan) * vrefint_cal / read(vrefChan);
+        return 30000 + (raw - temp_30) * 80000 / (temp_110 - temp_30);
     }
 };
 
@@ -574,7 +786,7 @@ struct Flash {
             return;
         unlock();
         MMIO32(cr) = (0<<8) | (1<<0); // PSIZE, PG
-        MMIO8((uint32_t) addr | 0x08000000) = val;
+        MMIO8((uint32_t) (uintptr_t) addr | 0x08000000) = val;
         finish();
     }
 
@@ -583,7 +795,7 @@ struct Flash {
             return;
         unlock();
         MMIO32(cr) = (1<<8) | (1<<0); // PSIZE, PG
-        MMIO16((uint32_t) addr | 0x08000000) = val;
+        MMIO16((uint32_t) (uintptr_t) addr | 0x08000000) = val;
         finish();
     }
 
@@ -592,7 +804,7 @@ struct Flash {
             return;
         unlock();
         MMIO32(cr) = (2<<8) | (1<<0); // PSIZE, PG
-        MMIO32((uint32_t) addr | 0x08000000) = val;
+        MMIO32((uint32_t) (uintptr_t) addr | 0x08000000) = val;
         finish();
     }
 
@@ -602,12 +814,12 @@ struct Flash {
         unlock();
         MMIO32(cr) = (2<<8) | (1<<0); // PSIZE, PG
         for (int i = 0; i < len; ++i)
-            MMIO32(((uint32_t) a + 4*i) | 0x08000000) = ptr[i];
+            MMIO32(((uint32_t) (uintptr_t) a + 4*i) | 0x08000000) = ptr[i];
         finish();
     }
 
     static void erasePage (void const* addr) {
-        uint32_t a = (uint32_t) addr & 0x07FFFFFF;
+        uint32_t a = (uint32_t) (uintptr_t) addr & 0x07FFFFFF;
         // sectors are 16/16/16/16/64/128... KB
         int sector = a < 0x10000 ? (a >> 14) :
                      a < 0x20000 ? (a >> 16) + 3 :
@@ -648,13 +860,43 @@ struct Timer {
                                 N == 14 ?  8 :  // TIM14, APB1
                                           64;   // else TIM1
 
+    // nvic irq number of the update interrupt, some are shared [1] p.374
+    constexpr static int irq  = N ==  1 ? 25 :  // TIM1_UP_TIM10
+                                N ==  2 ? 28 :
+                                N ==  3 ? 29 :
+                                N ==  4 ? 30 :
+                                N ==  5 ? 50 :
+                                N ==  6 ? 54 :  // TIM6_DAC
+                                N ==  7 ? 55 :
+                                N ==  8 ? 44 :  // TIM8_UP_TIM13
+                                N ==  9 ? 24 :  // TIM1_BRK_TIM9
+                                N == 10 ? 25 :  // TIM1_UP_TIM10
+                                N == 11 ? 26 :  // TIM1_TRG_COM_TIM11
+                                N == 12 ? 43 :  // TIM8_BRK_TIM12
+                                N == 13 ? 44 :  // TIM8_UP_TIM13
+                                N == 14 ? 45 :  // TIM8_TRG_COM_TIM14
+                                          25;
+
+    // alternate function of the channel pins, [2] p.61
+    constexpr static int alt = N <=  2 ? 1 :  // TIM1, TIM2
+                               N <=  5 ? 2 :  // TIM3..5
+                               N <= 11 ? 3 :  // TIM8..11
+                                         9;   // TIM12..14
+
     constexpr static uint32_t base  = 0x40000000 + 0x400*tidx;
     constexpr static uint32_t cr1   = base + 0x00;
+    constexpr static uint32_t dier  = base + 0x0C;
+    constexpr static uint32_t sr    = base + 0x10;
+    constexpr static uint32_t egr   = base + 0x14;
     constexpr static uint32_t ccmr1 = base + 0x18;
+    constexpr static uint32_t ccmr2 = base + 0x1C;
     constexpr static uint32_t ccer  = base + 0x20;
+    constexpr static uint32_t cnt   = base + 0x24;
     constexpr static uint32_t psc   = base + 0x28;
     constexpr static uint32_t arr   = base + 0x2C;
+    constexpr static uint32_t rcr   = base + 0x30;
     constexpr static uint32_t ccr1  = base + 0x34;
+    constexpr static uint32_t bdtr  = base + 0x44;
 
     static void init (uint32_t limit, uint32_t scale =0) {
         if (tidx < 64)
@@ -663,15 +905,154 @@ struct Timer {
             Periph::bit(Periph::rcc+0x44, tidx-64) = 1;
         MMIO16(psc) = scale;
         MMIO32(arr) = limit-1;
+        MMIO32(egr) = 1<<0; // UG, else the prescaler only applies after a wrap
+        clear();
         Periph::bit(cr1, 0) = 1; // CEN
     }
 
-    // TODO TIM1 (and TIM8?) don't seem to work with PWM
-    static void pwm (uint32_t match) {
-        MMIO16(ccmr1) = 0x60; // PWM mode
-        MMIO32(ccr1) = match;
-        Periph::bit(ccer, 0) = 1; // CC1E
+    // overflow "hz" times per second, prescaled to fit 16-bit timers
+    static void initHz (uint32_t hz, uint32_t clock =defaultHz) {
+        uint32_t period = clock / hz;
+        uint32_t scale = (period - 1) >> 16;
+        init(period / (scale + 1), scale);
+    }
+
+    static void pwm (uint32_t match, int ch =1) {
+        MMIO32(ccr(ch)) = match;
+        output(ch, 0b110); // PWM mode 1
+    }
+
+    // compare register of channel 1..4
+    constexpr static uint32_t ccr (int ch) { return ccr1 + 4*(ch-1); }
+
+    // set the output compare mode of a channel and enable its output:
+    // 0b001 active on match, 0b010 inactive on match, 0b011 toggle on match,
+    // 0b100 force inactive, 0b101 force active, 0b110 PWM 1, 0b111 PWM 2
+    // with preload, compare values written later only apply on an update
+    static void output (int ch, int ocm, bool preload =false) {
+        uint32_t ccmr = ch <= 2 ? ccmr1 : ccmr2;
+        int shift = 8 * ((ch-1) & 1);
+        int mode = (ocm << 4) | (preload << 3); // OCxM, OCxPE
+        MMIO32(ccmr) = (MMIO32(ccmr) & ~(0xFF << shift)) | (mode << shift);
+        Periph::bit(ccer, 4*(ch-1)) = 1; // CCxE
+        if (N == 1 || N == 8)
+            Periph::bit(bdtr, 15) = 1; // MOE, gates all outputs of TIM1/TIM8
+    }
+
+    // change the output at counter value "at", e.g. 0b001 to go active
+    static void compare (int ch, uint32_t at, int ocm) {
+        MMIO32(ccr(ch)) = at;
+        output(ch, ocm);
+    }
+
+    // one-pulse mode: go active "delay" counts from now, stay active for
+    // "width" counts, then the counter stops by itself [1] p.544
+    // delay >= 1, delay + width must fit in the counter (16 or 32 bits)
+    static void pulse (int ch, uint32_t width, uint32_t delay =1) {
+        Periph::bit(cr1, 0) = 0; // stop
+        Periph::bit(cr1, 3) = 1; // OPM
+        MMIO32(cnt) = 0;
+        MMIO32(arr) = delay + width - 1;
+        compare(ch, delay, 0b111); // PWM 2, inactive until delay
+        Periph::bit(cr1, 0) = 1; // CEN, cleared by hardware at the end
+    }
+
+    // PWM at duty "first" for "periods" (1..256) cycles, then at duty "then",
+    // switched by hardware through the repetition counter (TIM1/TIM8 only)
+    static void pwmStep (int ch, uint32_t first, uint32_t then, int periods) {
+        MMIO32(rcr) = periods - 1;
+        MMIO32(ccr(ch)) = first;
+        output(ch, 0b110, true); // PWM 1, preloaded
+        MMIO32(egr) = 1<<0; // UG, load both now, next update after "periods"
+        MMIO32(ccr(ch)) = then;
+        MMIO32(rcr) = 0;
+    }
+
+    // count up to the limit and back down: PWM mode 1 pulses are centred
+    // on the counter valley, at half the frequency of init(limit)
+    // cms 1 flags (and ADC triggers) compare events only counting down,
+    // 2 only counting up, 3 both ways. The counter stops while switching
+    static void centered (int cms =1) {
+        Periph::bit(cr1, 0) = 0;
+        MMIO32(cr1) = (MMIO32(cr1) & ~(3<<5)) | (cms << 5); // CMS
+        Periph::bit(cr1, 0) = 1;
     }
+
+    // still counting, i.e. a pulse has not finished yet
+    static bool busy () { return Periph::bit(cr1, 0) != 0; }
+
+    // call a handler on each counter overflow, i.e. at a fixed rate
+    static void interrupt (VTable::Handler handler) {
+        switch (N) {
+            case  1: case 10: VTableRam().tim1_up_tim10 = handler; break;
+            case  2: VTableRam().tim2 = handler; break;
+            case  3: VTableRam().tim3 = handler; break;
+            case  4: VTableRam().tim4 = handler; break;
+            case  5: VTableRam().tim5 = handler; break;
+            case  6: VTableRam().tim6_dac = handler; break;
+            case  7: VTableRam().tim7 = handler; break;
+            case  8: case 13: VTableRam().tim8_up_tim13 = handler; break;
+            case  9: VTableRam().tim1_brk_tim9 = handler; break;
+            case 11: VTableRam().tim1_trg_com_tim11 = handler; break;
+            case 12: VTableRam().tim8_brk_tim12 = handler; break;
+            case 14: VTableRam().tim8_trg_com_tim14 = handler; break;
+        }
+
+        constexpr uint32_t nvic_iser = 0xE000E100;
+        MMIO32(nvic_iser + 4*(irq>>5)) = 1 << (irq & 0x1F);
+        Periph::bit(dier, 0) = 1; // UIE
+    }
+
+    // update event happened since the last clear, i.e. a period has elapsed
+    static bool pending () { return (MMIO32(sr) & (1<<0)) != 0; }
+    static void clear () { MMIO32(sr) = ~(1<<0); } // UIF is rc_w0
+    static uint32_t count () { return MMIO32(cnt); }
+};
+
+// external interrupts on gpio pins [1] p.380
+// lines 5..9 and 10..15 share one vector, the last init() there wins
+
+template< typename PIN >
+struct Exti {
+    constexpr static uint32_t base    = 0x40013C00;
+    constexpr static uint32_t imr     = base + 0x00;
+    constexpr static uint32_t rtsr    = base + 0x08;
+    constexpr static uint32_t ftsr    = base + 0x0C;
+    constexpr static uint32_t pr      = base + 0x14;
+    constexpr static uint32_t exticr1 = 0x40013800 + 0x08; // SYSCFG
+
+    constexpr static int line = PIN::id & 0xF;
+    constexpr static int irq = line < 5 ? 6 + line : line < 10 ? 23 : 40;
+
+    static void init (VTable::Handler handler, bool rising =true, bool falling =true) {
+        Periph::bit(Periph::rcc+0x44, 14) = 1; // SYSCFGEN
+        uint32_t cr = exticr1 + 4*(line>>2);
+        int shift = 4*(line&3);
+        MMIO32(cr) = (MMIO32(cr) & ~(0xF<<shift)) | ((PIN::id>>4) << shift);
+
+        switch (line) {
+            case 0: VTableRam().exti0 = handler; break;
+            case 1: VTableRam().exti1 = handler; break;
+            case 2: VTableRam().exti2 = handler; break;
+            case 3: VTableRam().exti3 = handler; break;
+            case 4: VTableRam().exti4 = handler; break;
+            default:
+                if (line < 10)
+                    VTableRam().exti9_5 = handler;
+                else
+                    VTableRam().exti15_10 = handler;
+        }
+
+        Periph::bit(rtsr, line) = rising;
+        Periph::bit(ftsr, line) = falling;
+        Periph::bit(imr, line) = 1;
+
+        constexpr uint32_t nvic_iser = 0xE000E100;
+        MMIO32(nvic_iser + 4*(irq>>5)) = 1 << (irq & 0x1F);
+    }
+
+    static bool pending () { return (MMIO32(pr) & (1<<line)) != 0; }
+    static void clear () { MMIO32(pr) = 1<<line; } // rc_w1
 };
 
 // cycle counts, see https://stackoverflow.com/questions/11530593/
@@ -679,8 +1060,14 @@ struct Timer {
 struct DWT {
     constexpr static uint32_t ctrl   = Periph::dwt + 0x0;
     constexpr static uint32_t cyccnt = Periph::dwt + 0x4;
+    constexpr static uint32_t demcr  = 0xE000EDFC;
 
-    static void start () { MMIO32(cyccnt) = 0; MMIO32(ctrl) |= 1<<0; }
+    // TRCENA must be set, else the counter stays at zero without a debugger
+    static void start () {
+        MMIO32(demcr) |= 1<<24;
+        MMIO32(cyccnt) = 0;
+        MMIO32(ctrl) |= 1<<0;
+    }
     static void stop () { MMIO32(ctrl) &= ~(1<<0); }
     static uint32_t count () { return MMIO32(cyccnt); }
 };
@@ -3,9 +3,12 @@
 #include <stdarg.h>
 #include <stdint.h>
 
+// register access, can be predefined to run the code against a simulator
+#ifndef MMIO32
 #define MMIO32(x) (*(volatile uint32_t*) (x))
 #define MMIO16(x) (*(volatile uint16_t*) (x))
 #define MMIO8(x)  (*(volatile uint8_t*) (x))
+#endif
 
 // general-purpose ring buffer
 